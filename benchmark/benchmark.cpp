@@ -41,7 +41,7 @@ int main() {
         expression = toExpression(normalized);
         tree = parseString(expression);
 
-        average_resulting_phenotype_length += tree.evaluate().toNormalizedVector().size();
+        average_resulting_phenotype_length += tree.evaluate(GTree::phenotype_arena).toNormalizedVector().size();
 
         i++;
         duration = sclock::now() - total_before;
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "genomus-core.hpp"
+
+using namespace std;
+
+using sclock = std::chrono::steady_clock;
+using msec = std::chrono::duration<double, std::milli>;
+
+// Usage: index_benchmark [indexed phenotypes = 20000] [queries = 200] [k = 10]
+int main(int argc, char** argv) {
+    init_genomus();
+
+    const size_t indexed = argc > 1 ? stoul(argv[1]) : 20000;
+    const size_t queries = argc > 2 ? stoul(argv[2]) : 200;
+    const size_t k = argc > 3 ? stoul(argv[3]) : 10;
+
+    cout << "##########    GENOMUS-CORE PHENOTYPE INDEX BENCHMARK    ##########\n" << endl;
+    cout << "Recall@" << k << " and query latency of PhenotypeIndex against a linear scan, over " << indexed
+         << " indexed phenotypes and " << queries << " queries.\n" << endl;
+
+    Population population;
+    population.reserve(indexed + queries, GERMINAL_VECTOR_MAX_LENGTH);
+    for (size_t n = 0; n < indexed + queries; ++n) population.add(newGerminalVector(), n);
+
+    auto before = sclock::now();
+    population.evaluateAll();
+    cout << "Evaluated " << population.size() << " phenotypes in " << msec(sclock::now() - before).count() << "ms" << endl;
+
+    vector<PhenotypeDescriptor> descriptors(population.size());
+    for (size_t n = 0; n < population.size(); ++n) descriptors[n] = toPhenotypeDescriptor(population.getPhenotypeVector(n));
+
+    // Exact neighbours of every query, by linear scan
+    vector<vector<size_t>> exact(queries);
+    before = sclock::now();
+    for (size_t q = 0; q < queries; ++q) {
+        vector<pair<double, size_t>> scan(indexed);
+        for (size_t n = 0; n < indexed; ++n) scan[n] = { l2Distance(descriptors[indexed + q], descriptors[n]), n };
+        partial_sort(scan.begin(), scan.begin() + min(k, indexed), scan.end());
+        for (size_t n = 0; n < min(k, indexed); ++n) exact[q].push_back(scan[n].second);
+    }
+    const double scan_latency = msec(sclock::now() - before).count() / queries;
+    cout << "Linear scan: " << scan_latency << "ms per query\n" << endl;
+
+    cout << setw(8) << "tables" << setw(8) << "hashes" << setw(8) << "width"
+         << setw(12) << "build ms" << setw(12) << "query ms" << setw(10) << "recall" << endl;
+
+    for (size_t tables : { 12, 24, 48 }) {
+        for (size_t hashes : { 4, 6 }) {
+            for (double width : { 0.25, 0.5 }) {
+                PhenotypeIndex index({ .tables = tables, .hashes_per_table = hashes, .bucket_width = width });
+
+                before = sclock::now();
+                parallelChunks(indexed, population.getThreads(), [&](size_t /*chunk*/, size_t begin, size_t end) {
+                    for (size_t n = begin; n < end; ++n) index.insert(descriptors[n], n);
+                });
+                const double build_time = msec(sclock::now() - before).count();
+
+                size_t found = 0, expected = 0;
+                before = sclock::now();
+                for (size_t q = 0; q < queries; ++q) {
+                    const auto neighbours = index.query(descriptors[indexed + q], k);
+                    for (size_t id : exact[q]) {
+                        expected++;
+                        found += any_of(neighbours.begin(), neighbours.end(), [&](auto& neighbour) { return neighbour.id == id; });
+                    }
+                }
+                const double query_latency = msec(sclock::now() - before).count() / queries;
+
+                cout << setw(8) << tables << setw(8) << hashes << setw(8) << width
+                     << setw(12) << build_time << setw(12) << query_latency << setw(10) << (double) found / expected << endl;
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "../library/genomus-core.hpp"
+
+using batch_clock = std::chrono::steady_clock;
+using milliseconds = std::chrono::duration<double, std::milli>;
+
+std::vector<std::string> readExpressions(std::istream& input) {
+    std::vector<std::string> expressions;
+    std::string expression;
+
+    while (std::getline(input, expression, ';')) {
+        expression = strip(expression);
+        if (expression != "") expressions.push_back(expression);
+    }
+
+    return expressions;
+}
+
+static void writeJSONString(std::ostream& os, const std::string& s) {
+    os << '"';
+    for (char c : s) {
+        switch (c) {
+            case '"': os << "\\\""; break;
+            case '\\': os << "\\\\"; break;
+            case '\n': os << "\\n"; break;
+            case '\r': os << "\\r"; break;
+            case '\t': os << "\\t"; break;
+            default:
+                if ((unsigned char) c < 0x20) {
+                    char escaped[7];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    os << escaped;
+                } else {
+                    os << c;
+                }
+        }
+    }
+    os << '"';
+}
+
+void writeJSONNumber(std::ostream& os, double value) {
+    if (!std::isfinite(value)) {
+        os << "null";
+        return;
+    }
+
+    char buffer[32];
+    auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    os.write(buffer, end - buffer);
+}
+
+static void writeJSONArray(std::ostream& os, const std::vector<double>& values) {
+    os << '[';
+    for (size_t k = 0; k < values.size(); ++k) {
+        if (k) os << ", ";
+        writeJSONNumber(os, values[k]);
+    }
+    os << ']';
+}
+
+static std::string evaluateExpression(size_t index, const std::string& expression, bool& failed) {
+    std::stringstream ss;
+    ss << "{\"index\": " << index << ", \"expression\": ";
+    writeJSONString(ss, expression);
+
+    try {
+        // No tree outlives its expression, so the thread context is emptied instead of collected
+        GTree::clean();
+
+        auto before = batch_clock::now();
+        dec_gen_t tree = parseString(expression);
+        const double parse_time = milliseconds(batch_clock::now() - before).count();
+
+        before = batch_clock::now();
+        const auto encoded_genotype = tree.toNormalizedVector();
+        const double genotype_encoding_time = milliseconds(batch_clock::now() - before).count();
+
+        before = batch_clock::now();
+        auto evaluated = tree.evaluate(GTree::phenotype_arena);
+        const double evaluate_time = milliseconds(batch_clock::now() - before).count();
+
+        before = batch_clock::now();
+        const auto phenotype = evaluated.toNormalizedVector();
+        const double phenotype_encoding_time = milliseconds(batch_clock::now() - before).count();
+
+        ss << ", \"decoded_genotype\": ";
+        writeJSONString(ss, tree.toString());
+        ss << ", \"encoded_genotype\": ";
+        writeJSONArray(ss, encoded_genotype);
+        ss << ", \"phenotype\": ";
+        writeJSONArray(ss, phenotype);
+        ss << ", \"timings_ms\": {\"parse\": ";
+        writeJSONNumber(ss, parse_time);
+        ss << ", \"encode_genotype\": ";
+        writeJSONNumber(ss, genotype_encoding_time);
+        ss << ", \"evaluate\": ";
+        writeJSONNumber(ss, evaluate_time);
+        ss << ", \"encode_phenotype\": ";
+        writeJSONNumber(ss, phenotype_encoding_time);
+        ss << "}}";
+        failed = false;
+    } catch (const std::exception& e) {
+        // Any failure belongs to its expression: it must not take the results of the others with it
+        ss << ", \"error\": ";
+        writeJSONString(ss, e.what());
+        ss << '}';
+        failed = true;
+    }
+
+    return ss.str();
+}
+
+size_t runBatch(const std::vector<std::string>& expressions, std::ostream& output, BatchOptions options) {
+    init_available_functions();
+
+    const size_t threads = options.threads ? options.threads : std::max<unsigned int>(1, std::thread::hardware_concurrency());
+    std::vector<std::string> results(expressions.size());
+    std::vector<char> failures(expressions.size());
+    std::atomic<size_t> next = 0;
+
+    // Expressions are handed out one at a time: their evaluation times vary by orders of magnitude
+    parallelChunks(threads, threads, [&](size_t /*chunk*/, size_t /*begin*/, size_t /*end*/) {
+        GTree::Context context;
+        GTree::Context::Scope scope(context);
+
+        for (size_t k = next++; k < expressions.size(); k = next++) {
+            bool failed;
+            results[k] = evaluateExpression(k, expressions[k], failed);
+            failures[k] = failed;
+        }
+
+        GTree::clean();
+    });
+
+    size_t failed = 0;
+    for (size_t k = 0; k < results.size(); ++k) {
+        output << results[k] << '\n';
+        failed += failures[k];
+    }
+    output.flush();
+
+    return failed;
+}
@@ -0,0 +1,33 @@
+#ifndef __GENOMUS_CORE_INTERPRETER_BATCH__
+#define __GENOMUS_CORE_INTERPRETER_BATCH__
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+    Batch mode evaluates every ;-terminated expression of an input, in parallel, and writes one JSON object per
+    expression and line (JSONL), in input order:
+
+        {"index": 0, "expression": "...", "decoded_genotype": "...", "encoded_genotype": [...],
+         "phenotype": [...], "timings_ms": {"parse": ..., "encode_genotype": ...,
+         "evaluate": ..., "encode_phenotype": ...}}
+
+    Expressions that fail are reported with an "error" field instead of the results. Values that are not
+    finite, which JSON cannot represent, are written as null. Every thread builds and
+    evaluates trees in a GTree::Context of its own, with its own phenotype arena.
+*/
+struct BatchOptions {
+    // 0 uses every hardware thread
+    size_t threads = 0;
+};
+
+// Splits an input in ;-terminated expressions. Expressions may span several lines
+std::vector<std::string> readExpressions(std::istream&);
+// Shortest representation that reads back to the same double, or null for NaN and infinities
+void writeJSONNumber(std::ostream&, double);
+// Returns the number of expressions that failed
+size_t runBatch(const std::vector<std::string>& expressions, std::ostream& output, BatchOptions options = {});
+
+#endif
@@ -0,0 +1,30 @@
+#include "bench.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+#include "../library/genomus-core.hpp"
+
+std::pair<std::string, size_t> parseBenchArguments(const std::string& arguments) {
+    const size_t separator = arguments.find_last_of(" \t\n");
+    if (separator != std::string::npos) {
+        const std::string last = arguments.substr(separator + 1);
+        if (last.size() && std::all_of(last.begin(), last.end(), [](char c) { return std::isdigit(c); })) {
+            std::string expression = arguments.substr(0, separator);
+            size_t iterations;
+            const auto [end, error] = std::from_chars(last.data(), last.data() + last.size(), iterations);
+            if (error != std::errc()) throw std::runtime_error("Too many iterations: " + last);
+            if (iterations == 0) throw std::runtime_error("Expected a positive number of iterations");
+            return { strip(expression), iterations };
+        }
+    }
+    return { arguments, BENCH_DEFAULT_ITERATIONS };
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    const size_t rank = std::ceil(p / 100 * sorted.size());
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
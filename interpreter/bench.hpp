@@ -0,0 +1,16 @@
+#ifndef __GENOMUS_CORE_INTERPRETER_BENCH__
+#define __GENOMUS_CORE_INTERPRETER_BENCH__
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#define BENCH_DEFAULT_ITERATIONS 100
+
+// Splits "<expression> N" arguments of \bench. The iteration count is optional, and a trailing word that is
+// not a number belongs to the expression. Counts of 0 or out of range are runtime errors.
+std::pair<std::string, size_t> parseBenchArguments(const std::string& arguments);
+// Nearest rank percentile of sorted values, which must not be empty
+double percentile(const std::vector<double>& sorted, double p);
+
+#endif
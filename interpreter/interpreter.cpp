@@ -1,9 +1,15 @@
 #include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <numeric>
 #include <sstream>
 #include <stdexcept>
 
 #include "../library/genomus-core.hpp"
+#include "batch.hpp"
+#include "bench.hpp"
 
 #define PROMPT "> "
 #define FOLLOW_UP_PROMPT "> ... "
@@ -15,17 +21,124 @@ static const std::string WELCOME =
     "and see what happens!\n\n";
     // "List of commands: ";
 
+static const std::string USAGE =
+    "Usage:\n"
+    "  interpreter                      Interactive mode\n"
+    "  interpreter --batch [FILE | -]   Evaluate the ;-terminated expressions of FILE (default: standard input)\n"
+    "                                   and write the results as JSONL, in input order\n"
+    "    --threads N                    Evaluate on N threads (default: every hardware thread)\n"
+    "    --output FILE                  Write the results to FILE (default: standard output)\n";
+
+using interpreter_clock = std::chrono::steady_clock;
+using milliseconds = std::chrono::duration<double, std::milli>;
+
+static std::string formatDuration(double ms) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3);
+    if (ms < 1) {
+        ss << ms * 1000 << " us";
+    } else {
+        ss << ms << " ms";
+    }
+    return ss.str();
+}
+
+// Parses, encodes and evaluates an expression in a context of its own, timing every stage
+static std::string timeExpression(const std::string& expression) {
+    GTree::Context context;
+    GTree::Context::Scope scope(context);
+
+    auto before = interpreter_clock::now();
+    dec_gen_t tree = parseString(expression);
+    const double parse_time = milliseconds(interpreter_clock::now() - before).count();
+
+    before = interpreter_clock::now();
+    const auto encoded_genotype = tree.toNormalizedVector();
+    const double genotype_encoding_time = milliseconds(interpreter_clock::now() - before).count();
+
+    before = interpreter_clock::now();
+    auto phenotype = tree.evaluate(GTree::phenotype_arena);
+    const double evaluate_time = milliseconds(interpreter_clock::now() - before).count();
+
+    before = interpreter_clock::now();
+    const auto encoded_phenotype = phenotype.toNormalizedVector();
+    const double phenotype_encoding_time = milliseconds(interpreter_clock::now() - before).count();
+
+    std::stringstream ss;
+    ss << std::left
+       << std::setw(20) << "parse" << formatDuration(parse_time) << '\n'
+       << std::setw(20) << "encode genotype" << formatDuration(genotype_encoding_time) << " (" << encoded_genotype.size() << " values)\n"
+       << std::setw(20) << "evaluate" << formatDuration(evaluate_time) << '\n'
+       << std::setw(20) << "encode phenotype" << formatDuration(phenotype_encoding_time) << " (" << encoded_phenotype.size() << " values)\n"
+       << std::setw(20) << "total" << formatDuration(parse_time + genotype_encoding_time + evaluate_time + phenotype_encoding_time);
+    return ss.str();
+}
+
+static std::string profileExpression(const std::string& expression) {
+    GTree::Context context;
+    GTree::Context::Scope scope(context);
+
+    dec_gen_t tree = parseString(expression);
+
+    Profiler::reset();
+    tree.evaluate(GTree::phenotype_arena);
+    return Profiler::toTable();
+}
+
+// Evaluates an expression iterations times. The phenotype arena is released between evaluations,
+// so every evaluation starts from the same state.
+static std::string benchExpression(const std::string& expression, size_t iterations) {
+    GTree::Context context;
+    GTree::Context::Scope scope(context);
+
+    dec_gen_t tree = parseString(expression);
+
+    std::vector<double> latencies;
+    latencies.reserve(iterations);
+    uint64_t allocations = 0;
+
+    for (size_t k = 0; k < iterations; ++k) {
+        const uint64_t allocations_before = Profiler::allocationCount();
+        const auto before = interpreter_clock::now();
+        tree.evaluate(GTree::phenotype_arena);
+        latencies.push_back(milliseconds(interpreter_clock::now() - before).count());
+        allocations += Profiler::allocationCount() - allocations_before;
+
+        GTree::phenotype_arena.reset();
+    }
+
+    const double total = std::accumulate(latencies.begin(), latencies.end(), 0.0);
+    std::sort(latencies.begin(), latencies.end());
+
+    std::stringstream ss;
+    ss << iterations << " evaluations in " << formatDuration(total) << "\n" << std::left
+       << std::setw(12) << "mean" << formatDuration(total / iterations) << '\n'
+       << std::setw(12) << "min" << formatDuration(latencies.front()) << '\n'
+       << std::setw(12) << "p50" << formatDuration(percentile(latencies, 50)) << '\n'
+       << std::setw(12) << "p90" << formatDuration(percentile(latencies, 90)) << '\n'
+       << std::setw(12) << "p99" << formatDuration(percentile(latencies, 99)) << '\n'
+       << std::setw(12) << "max" << formatDuration(latencies.back()) << '\n'
+       << std::setw(12) << "allocations";
+
+    if (Profiler::enabled()) {
+        ss << std::fixed << std::setprecision(1) << (double) allocations / iterations << " per evaluation";
+    } else {
+        ss << "not available: build with -DGENOMUS_PROFILING=ON";
+    }
+    return ss.str();
+}
+
 typedef struct {
     std::string command;
     std::string description;
-    std::function<std::string()> get_output;
+    std::function<std::string(const std::string& arguments)> get_output;
 } Command;
 
 static const std::vector<Command> commands({
     {
         .command = "\\list",
         .description = "List available functions",
-        .get_output = []() {
+        .get_output = [](const std::string&) {
             std::vector<std::string> v;
             for_each(available_functions.begin(), available_functions.end(), [&](auto& entry) {
                 v.push_back(entry.second.getName());
@@ -36,7 +149,7 @@ static const std::vector<Command> commands({
     {
         .command = "\\list_verbose",
         .description = "List available functions with additional information",
-        .get_output = []() {
+        .get_output = [](const std::string&) {
             std::vector<std::string> v;
             for_each(available_functions.begin(), available_functions.end(), [&](auto& entry) {
                 v.push_back(entry.second.toString());
@@ -44,10 +157,32 @@ static const std::vector<Command> commands({
             return join(v, "\n");
         }
     },
+    {
+        .command = "\\time",
+        .description = "\\time <expression>: Time parsing, evaluation and the encoding of the genotype and phenotype",
+        .get_output = [](const std::string& expression) {
+            return timeExpression(expression);
+        }
+    },
+    {
+        .command = "\\profile",
+        .description = "\\profile <expression>: Calls, time and allocations of every function in an evaluation",
+        .get_output = [](const std::string& expression) {
+            return profileExpression(expression);
+        }
+    },
+    {
+        .command = "\\bench",
+        .description = "\\bench <expression> [N]: Evaluate N times (default " + std::to_string(BENCH_DEFAULT_ITERATIONS) + ") and report latency percentiles",
+        .get_output = [](const std::string& arguments) {
+            auto [expression, iterations] = parseBenchArguments(arguments);
+            return benchExpression(expression, iterations);
+        }
+    },
     {
         .command = "\\q",
         .description = "Quit",
-        .get_output = []() {
+        .get_output = [](const std::string&) {
             exit(0);
             return "";
         }
@@ -70,12 +205,17 @@ std::string getInfo(dec_gen_t&& tree) {
     return ss.str();
 }
 
-void handleCommand(std::string command) {
+void handleCommand(std::string input) {
+    const size_t separator = std::min(input.find_first_of(" \t\n"), input.size());
+    const std::string command = input.substr(0, separator);
+    std::string arguments = input.substr(separator);
+    arguments = strip(arguments);
+
     auto it = std::find_if(commands.begin(), commands.end(), [&](const Command& c) { return c.command == command; });
     if (it == commands.end()) {
         std::cout << "Unknown command: " << command << std::endl;
     } else {
-        std::cout << it -> get_output() << std::endl;
+        std::cout << it -> get_output(arguments) << std::endl;
     }
 }
 
@@ -92,12 +232,16 @@ void handleInput(std::string input) {
         } else {
             std::cout << getInfo(parseString(input)) << std::endl;
         }
-    } catch (std::runtime_error e) {
+    } catch (const std::exception& e) {
         std::cout << "ERROR: " << e.what() << std::endl;
     }
+
+    // No tree outlives its input, so every node is released at once and long sessions do not grow.
+    // collect() would only be needed to keep trees across inputs
+    GTree::clean();
 }
 
-int main() {
+int runInteractive() {
     std::string input;
     std::string line_input;
     bool complete_input;
@@ -109,9 +253,12 @@ int main() {
         input = "";
         complete_input = false;
         while (!complete_input) {
-            getline(std::cin, line_input, '\n');
+            if (!getline(std::cin, line_input, '\n')) {
+                std::cout << std::endl;
+                return 0;
+            }
             input += line_input;
-            complete_input = input[input.size() - 1] == ';';
+            complete_input = input.size() && input[input.size() - 1] == ';';
             if (!complete_input)
                 std::cout << FOLLOW_UP_PROMPT;
         }
@@ -122,4 +269,63 @@ int main() {
         std::cout << PROMPT;
     }
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    if (args.empty()) {
+        return runInteractive();
+    }
+
+    std::string input_path = "-", output_path = "-";
+    BatchOptions options;
+    bool batch = false;
+
+    try {
+        for (size_t k = 0; k < args.size(); ++k) {
+            if (args[k] == "--batch") {
+                batch = true;
+                if (k + 1 < args.size() && args[k + 1].rfind("--", 0) != 0) input_path = args[++k];
+            } else if (args[k] == "--threads" && k + 1 < args.size()) {
+                options.threads = std::stoul(args[++k]);
+            } else if (args[k] == "--output" && k + 1 < args.size()) {
+                output_path = args[++k];
+            } else {
+                throw std::invalid_argument(args[k]);
+            }
+        }
+    } catch (std::logic_error& e) {
+        std::cerr << "Bad argument: " << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+
+    if (!batch) {
+        std::cerr << USAGE;
+        return 2;
+    }
+
+    std::ifstream input_file;
+    std::ofstream output_file;
+
+    if (input_path != "-") {
+        input_file.open(input_path);
+        if (!input_file) {
+            std::cerr << "Cannot read " << input_path << std::endl;
+            return 2;
+        }
+    }
+
+    if (output_path != "-") {
+        output_file.open(output_path);
+        if (!output_file) {
+            std::cerr << "Cannot write " << output_path << std::endl;
+            return 2;
+        }
+    }
+
+    const auto expressions = readExpressions(input_path == "-" ? std::cin : input_file);
+    const size_t failed = runBatch(expressions, output_path == "-" ? std::cout : output_file, options);
+
+    return failed ? 1 : 0;
+}
@@ -1,6 +1,8 @@
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <math.h>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -12,6 +14,8 @@
 #include "species.hpp"
 #include "utils.hpp"
 #include "errorCodes.hpp"
+#include "profiler.hpp"
+#include "result.hpp"
 
 // utils
 
@@ -93,9 +97,27 @@ EncodedPhenotypeType listToParameterType(EncodedPhenotypeType listType) {
 // GTree::GTreeIndex method implementation
 
 GTree::GTreeIndex::GTreeIndex(size_t i) { this -> _index = i; }
-enc_phen_t GTree::GTreeIndex::evaluate(){ return tree_nodes[this -> _index].evaluate(); }
-std::string GTree::GTreeIndex::toString() const { 
-    return tree_nodes[this -> _index].toString(); 
+// Copies are placed on the heap, out of the arena the phenotype was built in
+static enc_phen_t ownedCopy(const enc_phen_t& phenotype) { return enc_phen_t(phenotype); }
+
+enc_phen_t GTree::GTreeIndex::evaluate() const { 
+    return ownedCopy(this -> evaluate(phenotype_arena)); 
+}
+Result<enc_phen_t> GTree::GTreeIndex::tryEvaluate() const { 
+    Result<enc_phen_t> phenotype = this -> tryEvaluate(phenotype_arena);
+    if (!phenotype) return phenotype.error();
+    return ownedCopy(*phenotype);
+}
+enc_phen_t GTree::GTreeIndex::evaluate(PhenotypeArena& arena) const { 
+    PhenotypeArena::Scope arena_scope(arena);
+    return tree_nodes[this -> _index].evaluate(); 
+}
+Result<enc_phen_t> GTree::GTreeIndex::tryEvaluate(PhenotypeArena& arena) const { 
+    PhenotypeArena::Scope arena_scope(arena);
+    return tree_nodes[this -> _index].tryEvaluate(); 
+}
+std::string GTree::GTreeIndex::toString(ExpressionStyle style) const { 
+    return tree_nodes[this -> _index].toString(style); 
 }
 GTree::GTreeIndex::operator size_t() const { return this -> _index; }
 GTree::GTreeIndex::operator std::string() const { return this -> toString(); }
@@ -112,27 +134,39 @@ std::vector<double> GTree::GTreeIndex::toNormalizedVector() {
     return tree_nodes[this -> _index].toNormalizedVector();
 }
 
-EncodedPhenotype GTree::evaluateAutoreference(EncodedPhenotypeType eptt, size_t index, size_t depth_first_index) {
-    std::vector<GTree::GTreeIndex> available_subexpressions_for_type = GTree::available_subexpressions[eptt];
+Result<GTree::GTreeIndex> GTree::_autoreferenceTarget(const std::map<EncodedPhenotypeType, std::vector<GTree::GTreeIndex>>& subexpressions, 
+    EncodedPhenotypeType eptt, size_t index, size_t first_index, size_t depth_first_index) {
+    const auto it = subexpressions.find(eptt);
+    const GenomusError bad_autoreference = { .code = ErrorCodes::bad_autoreference, .position = depth_first_index, .function = {} };
 
-    if (available_subexpressions_for_type.size() == 0 || depth_first_index == 0) {
-        throw std::runtime_error(ErrorCodes::BAD_AUTOREFERENCE);
+    if (it == subexpressions.end() || it -> second.size() == 0 || depth_first_index == 0) {
+        return bad_autoreference;
     }
 
-    // i is the position of the autoreference in the available subexpressions ofr type
-    size_t i;
-    for (i = 0; i < available_subexpressions_for_type.size(); ++i) {
-        if (available_subexpressions_for_type[i] >= depth_first_index) {
-            break;
-        }
-    }
+    const std::vector<GTree::GTreeIndex>& available_subexpressions_for_type = it -> second;
+    const auto position = [&](size_t node_index) -> size_t {
+        return std::lower_bound(
+            available_subexpressions_for_type.begin(), 
+            available_subexpressions_for_type.end(), 
+            node_index,
+            [](GTree::GTreeIndex subexpression, size_t index) { return subexpression.getIndex() < index; }
+        ) - available_subexpressions_for_type.begin();
+    };
+
+    // The autoreference chooses among the subexpressions of type from first_index on and before itself,
+    // which are sorted by index
+    const size_t first = position(first_index);
+    const size_t i = position(depth_first_index) - first;
 
     if (i == 0) {
-        throw std::runtime_error(ErrorCodes::BAD_AUTOREFERENCE);
+        return bad_autoreference;
     }
 
-    size_t mod_index = index % i;
-    return available_subexpressions_for_type[mod_index].evaluate();
+    return available_subexpressions_for_type[first + index % i];
+}
+
+EncodedPhenotype GTree::evaluateAutoreference(EncodedPhenotypeType eptt, size_t index, size_t depth_first_index) {
+    return GTree::_autoreferenceTarget(GTree::available_subexpressions, eptt, index, 0, depth_first_index).valueOrThrow().evaluate();
 }
 
 void GTree::registerLastInsertedNodeAsSubexpression() {
@@ -165,25 +199,30 @@ std::string GTree::printStaticData() {
 }
 
 std::string unalias_name(std::string name) {
-    static std::string unaliased_name;
-    unaliased_name = name_aliases.find(name) == name_aliases.end() ? name : name_aliases[name];
-    return unaliased_name;
+    auto it = name_aliases.find(name);
+    return it == name_aliases.end() ? name : it -> second;
 }
 
 // GTree::GFunction method implementation
 
-std::vector<GTree> GTree::tree_nodes;
-RandomGenerator GTree::RNG;
-std::map<EncodedPhenotypeType, std::vector<GTree::GTreeIndex>> GTree::available_subexpressions;
+// Each thread builds and evaluates trees on its own set of static data
+thread_local std::vector<GTree> GTree::tree_nodes;
+thread_local PhenotypeArena GTree::phenotype_arena;
+thread_local RandomGenerator GTree::RNG;
+thread_local std::map<EncodedPhenotypeType, std::vector<GTree::GTreeIndex>> GTree::available_subexpressions;
 
 std::string GTree::GFunction::getName() { return this -> _name; };
+std::string_view GTree::GFunction::getNameView() const { return this -> _name; };
+std::string_view GTree::GFunction::getExplicitName() const { return this -> _explicit_name; };
 
 GTree::GFunction::GFunction(){ 
     this -> _name = "Not initialized decoded_genotype_level_function";
+    this -> _explicit_name = this -> _name;
     this -> _index = 0;
+    this -> _encoded_index = 0;
     this -> _type = decoded_genotype_level_function;
-    this -> _param_types = std::vector<EncodedPhenotypeType>();
-    this -> _compute = [](std::vector<enc_phen_t> x) -> enc_phen_t { return Parameter(-1.0); };
+    this -> _param_types = Signature();
+    this -> _compute = [](std::span<enc_phen_t> x) -> enc_phen_t { return Parameter(-1.0); };
     this -> _output_type = leafF;
     this -> _default_function_for_type = false;
     this -> _is_Autoreference = false;
@@ -192,7 +231,9 @@ GTree::GFunction::GFunction(){
 
 GTree::GFunction::GFunction(const GTree::GFunction& gf) {
     this -> _name = gf._name;
+    this -> _explicit_name = gf._explicit_name;
     this -> _index = gf._index;
+    this -> _encoded_index = gf._encoded_index;
     this -> _type = gf._type;
     this -> _param_types = gf._param_types;
     this -> _compute = gf._compute;
@@ -205,8 +246,10 @@ GTree::GFunction::GFunction(const GTree::GFunction& gf) {
 
 GTree::GFunction::GFunction(const GTree::GFunction& gf, std::string name) {
     this -> _name = name != "" ? name : gf._name;
+    this -> _explicit_name = unalias_name(this -> _name);
     this -> _type = gf._type;
     this -> _index = gf._index;
+    this -> _encoded_index = gf._encoded_index;
     this -> _param_types = gf._param_types;
     this -> _compute = gf._compute;
     this -> _output_type = gf._output_type;
@@ -217,9 +260,11 @@ GTree::GFunction::GFunction(const GTree::GFunction& gf, std::string name) {
 
 GTree::GFunction::GFunction(GFunctionInitializer init) {
     this -> _name = init.name;
+    this -> _explicit_name = unalias_name(this -> _name);
     this -> _type = decoded_genotype_level_function;
     this -> _index = init.index;
-    this -> _param_types = init.param_types;
+    this -> _encoded_index = encodeIndex(init.index);
+    this -> _param_types = Signature(init.param_types.begin(), init.param_types.end());
     this -> _compute = init.compute;
     this -> _output_type = init.output_type;
     this -> _is_Autoreference  = init.is_Autoreference;
@@ -237,20 +282,45 @@ GTree::GFunction GTree::GFunction::alias(std::string alias_name) {
     return GTree::GFunction({
         .name = alias_name,
         .index = this -> _index,
-        .param_types = this -> _param_types,
+        .param_types = std::vector<EncodedPhenotypeType>(this -> _param_types.begin(), this -> _param_types.end()),
         .output_type = this -> _output_type,
-        .compute = [&](std::vector<enc_phen_t> params) -> enc_phen_t {
-            return this -> _compute(params);
-        },
+        .compute = this -> _compute,
     });
 }
 
-void GTree::GFunction::_assert_parameter_format(const std::vector<enc_phen_t>& arg) const {
-    std::vector<EncodedPhenotypeType> arg_types;
-    for_each(arg.begin(), arg.end(), [&](enc_phen_t argument) { arg_types.push_back(argument.getType()); });
-    if (!this -> _is_Autoreference && (this -> _param_types != arg_types)) {
-        throw std::runtime_error(ErrorCodes::BAD_GFUNCTION_PARAMETERS + ": " + this -> _name);
+std::optional<size_t> GTree::GFunction::_mismatchingParameter(std::span<const GTree::GTreeIndex> children) const {
+    const auto childType = [](GTree::GTreeIndex child) { return tree_nodes[child]._function.getOutputType(); };
+
+    if (isEncodedPhenotypeTypeAListType(this -> _output_type)) {
+        // Lists take any number of parameters
+        for (size_t i = 0; i < children.size(); ++i) {
+            if (!isEncodedPhenotypeTypeAParameterType(childType(children[i]))) return i;
+        }
+        return std::nullopt;
+    }
+
+    for (size_t i = 0; i < children.size() && i < this -> _param_types.size(); ++i) {
+        if (childType(children[i]) != this -> _param_types[i]) return i;
+    }
+
+    if (children.size() != this -> _param_types.size()) {
+        return std::min(children.size(), this -> _param_types.size());
+    }
+    return std::nullopt;
+}
+
+std::string GTree::GFunction::_parameterFormatMessage(std::span<const GTree::GTreeIndex> children, size_t mismatch) const {
+    if (isEncodedPhenotypeTypeAListType(this -> _output_type)) {
+        return ErrorCodes::BAD_GFUNCTION_PARAMETERS + ": " + this -> _name + " expects parameters.";
     }
+
+    if (children.size() != this -> _param_types.size()) {
+        return ErrorCodes::BAD_GFUNCTION_PARAMETERS + ": " + this -> _name + " expects " 
+            + std::to_string(this -> _param_types.size()) + " arguments.";
+    }
+
+    return ErrorCodes::BAD_GFUNCTION_PARAMETERS + ": " + this -> _name + " expects " 
+        + encodedPhenotypeTypeToString(this -> _param_types[mismatch]) + " as argument " + std::to_string(mismatch) + ".";
 }
 
 EncodedPhenotypeType GTree::GFunction::getOutputType() const { return this -> _output_type; }
@@ -258,25 +328,35 @@ bool GTree::GFunction::getIsAutoreference() const { return this -> _is_Autorefer
 bool GTree::GFunction::getIsDefaultForType() const { return this -> _default_function_for_type; };
 bool GTree::GFunction::getIsRandom() const { return this -> _is_random; };
 
-enc_phen_t GTree::GFunction::evaluate(const std::vector<enc_phen_t>& arg) const { 
-    // this -> _assert_parameter_format(arg);
+enc_phen_t GTree::GFunction::evaluate(std::span<enc_phen_t> arg) const { 
+    GENOMUS_PROFILE_SCOPE(this -> _name, Profiler::function_compute);
     return this -> _compute(arg); 
 }
 
 GTree::GTreeIndex GTree::GFunction::operator()(std::initializer_list<GTree::GTreeIndex> children) {
-    GTree::tree_nodes.push_back(GTree(
-        *this,
-        children,
-        0,
-        tree_nodes.size()
-    ));
+    return (*this)(std::span<const GTree::GTreeIndex>(children.begin(), children.size()));
+}
 
-    GTree::registerLastInsertedNodeAsSubexpression();
+GTree::GTreeIndex GTree::GFunction::operator()(std::span<const GTree::GTreeIndex> children) {
+    Result<GTree::GTreeIndex> node = this -> tryApply(children);
+    if (!node) throw std::runtime_error(this -> _parameterFormatMessage(children, node.error().position));
+
+    return *node;
+}
+
+GTree::GTreeIndex GTree::GFunction::operator()(double x) {
+    Result<GTree::GTreeIndex> node = this -> tryApply(x);
 
-    return tree_nodes.size() - 1;
+    if (node) return *node;
+    if (node.error().code == ErrorCodes::bad_autoreference_index) throw std::runtime_error(ErrorCodes::BAD_AUTOREFERENCE_INDEX);
+    throw std::runtime_error(ErrorCodes::BAD_GFUNCTION_PARAMETERS + ": " + this -> _name + " does not accept a double parameter.");
 }
 
-GTree::GTreeIndex GTree::GFunction::operator()(const std::vector<GTree::GTreeIndex> children) {
+Result<GTree::GTreeIndex> GTree::GFunction::tryApply(std::span<const GTree::GTreeIndex> children) {
+    if (const std::optional<size_t> mismatch = this -> _mismatchingParameter(children)) {
+        return GenomusError{ .code = ErrorCodes::bad_gfunction_parameters, .position = *mismatch, .function = this -> _name };
+    }
+
     GTree::tree_nodes.push_back(GTree(
         *this,
         children,
@@ -286,18 +366,18 @@ GTree::GTreeIndex GTree::GFunction::operator()(const std::vector<GTree::GTreeInd
 
     GTree::registerLastInsertedNodeAsSubexpression();
 
-    return tree_nodes.size() - 1;
+    return GTree::GTreeIndex(tree_nodes.size() - 1);
 }
 
-GTree::GTreeIndex GTree::GFunction::operator()(double x) {
+Result<GTree::GTreeIndex> GTree::GFunction::tryApply(double x) {
     if (!gfunctionAcceptsNumericParameter(*this)) {
         // Only parameter functions and Autoreferences are allowed to receive a numeric parameter
-        throw std::runtime_error(ErrorCodes::BAD_GFUNCTION_PARAMETERS + ": " + this -> _name + " does not accept a double parameter.");
+        return GenomusError{ .code = ErrorCodes::bad_gfunction_parameters, .position = 0, .function = this -> _name };
     }
     
     if (this -> _is_Autoreference) {
         if (x > tree_nodes.size() - 1) {
-            throw std::runtime_error(ErrorCodes::BAD_AUTOREFERENCE_INDEX);
+            return GenomusError{ .code = ErrorCodes::bad_autoreference_index, .position = 0, .function = this -> _name };
         }
     }
 
@@ -307,7 +387,7 @@ GTree::GTreeIndex GTree::GFunction::operator()(double x) {
 
     GTree::registerLastInsertedNodeAsSubexpression();
 
-    return tree_nodes.size() - 1;
+    return GTree::GTreeIndex(tree_nodes.size() - 1);
 }
 
 std::string GTree::GFunction::toString() { 
@@ -316,7 +396,7 @@ std::string GTree::GFunction::toString() {
     ret += "\n\t_name: " + this -> getName();
     // ret += "\n\t_type: " + EncodedPhenotypeTypeToString(this);
     ret += "\n\t_param_types: ";
-    for_each(this -> _param_types.begin(), this -> _param_types.end(), [&ret](EncodedPhenotypeType ft){ ret += encodedPhenotypeTypeToString(ft) + ", "; });
+    std::for_each(this -> _param_types.begin(), this -> _param_types.end(), [&ret](EncodedPhenotypeType ft){ ret += encodedPhenotypeTypeToString(ft) + ", "; });
     ret = ret.substr(0, ret.length() - 2) + ";";
 
     ret += "\n\t_output_type: " + encodedPhenotypeTypeToString(this -> _output_type) + ";";
@@ -324,10 +404,11 @@ std::string GTree::GFunction::toString() {
     return ret + "\n";
 }
 
-std::vector<EncodedPhenotypeType> GTree::GFunction::getParamTypes() const { return this -> _param_types; }
+std::span<const EncodedPhenotypeType> GTree::GFunction::getParamTypes() const { return this -> _param_types; }
 size_t GTree::GFunction::getIndex() const { return this -> _index; }
+double GTree::GFunction::getEncodedIndex() const { return this -> _encoded_index; }
 std::string GTree::GFunction::buildExplicitForm(std::vector<std::string> v) {
-    return unalias_name(this -> _name) + "(" + join(v) + ")";
+    return this -> _explicit_name + "(" + join(v) + ")";
 }
 
 // GTree method implementation
@@ -335,113 +416,418 @@ std::string GTree::GFunction::buildExplicitForm(std::vector<std::string> v) {
 void GTree::clean() {
     tree_nodes.clear();
     available_subexpressions.clear();
+    phenotype_arena.reset();
+}
+
+size_t GTree::collect(std::span<GTree::GTreeIndex> roots) {
+    // Every node of a root lies between its first node and the root, and autoreferences only choose among
+    // the nodes in between. Nodes built in between that are not part of the root are kept too, since they
+    // may be chosen.
+    std::vector<bool> reachable(tree_nodes.size(), false);
+    for (auto root : roots) {
+        std::fill(reachable.begin() + tree_nodes[root]._first_index, reachable.begin() + root + 1, true);
+    }
+
+    std::vector<size_t> new_index(tree_nodes.size());
+    std::vector<GTree> survivors;
+    survivors.reserve(std::count(reachable.begin(), reachable.end(), true));
+    available_subexpressions.clear();
+
+    for (size_t k = 0; k < tree_nodes.size(); ++k) {
+        if (!reachable[k]) continue;
+
+        new_index[k] = survivors.size();
+        GTree& node = survivors.emplace_back(std::move(tree_nodes[k]));
+        node._depth_first_index = new_index[k];
+        node._first_index = new_index[node._first_index];
+        for (auto& child : node._children) child = new_index[child];
+
+        available_subexpressions[node._function.getOutputType()].push_back(new_index[k]);
+    }
+
+    for (auto& root : roots) root = new_index[root];
+
+    const size_t released = tree_nodes.size() - survivors.size();
+    tree_nodes.swap(survivors);
+    phenotype_arena.reset();
+
+    return released;
 }
 
-GTree::GTree(GTree::GFunction& function, std::vector<GTree::GTreeIndex> children, double leaf_value, size_t depth_first_index): _function(function) {
-    this -> _children = children;
+// GTree::Context
+
+static void swapWithStaticData(GTree::Context& context) {
+    GTree::tree_nodes.swap(context.tree_nodes);
+    GTree::available_subexpressions.swap(context.available_subexpressions);
+    GTree::phenotype_arena.swap(context.phenotype_arena);
+    std::swap(GTree::RNG, context.RNG);
+}
+
+GTree::Context::Scope::Scope(GTree::Context& context) : _context(context) { swapWithStaticData(this -> _context); }
+GTree::Context::Scope::~Scope() { swapWithStaticData(this -> _context); }
+
+GTree::GTree(GTree::GFunction& function, std::span<const GTree::GTreeIndex> children, double leaf_value, size_t depth_first_index)
+    : _function(function), _children(children) {
     this -> _leaf_value = leaf_value;
+    this -> _isRandomEvaluated = false;
     this -> _depth_first_index = depth_first_index;
+    this -> _first_index = depth_first_index;
+    for (auto child : children) this -> _first_index = std::min(this -> _first_index, tree_nodes[child]._first_index);
 }
 
-enc_phen_t GTree::evaluate() {
+std::span<const GTree::GTreeIndex> GTree::getChildren() const { return this -> _children; }
+
+enc_phen_t GTree::_evaluateLeaf() {
+    GENOMUS_PROFILE_SCOPE(this -> _function.getNameView(), Profiler::tree_node);
+
     if (gfunctionAcceptsNumericParameter(this -> _function)) {
+        enc_phen_t leaf({
+            .type = leafF,
+            .child_type = leafF,
+            .children = {},
+            .format = value_format,
+            .leaf_value = this -> _leaf_value,
+        });
+        return this -> _function.evaluate({ &leaf, 1 });
+    }
+
+    // Random leaves are drawn once, and keep their value: a draw may be 0 as any other value
+    if (!this -> _isRandomEvaluated) {
+        auto result = this -> _function.evaluate({});
+        this -> _leaf_value = result.getLeafValue();
+        this -> _isRandomEvaluated = true;
+        return result;
+    }
+
+    enc_phen_t leaf({
+        .type = this -> _function.getOutputType(),
+        .child_type = leafF,
+        .children = {},
+        .label = this -> _function.getNameView(),
+        .format = labelled_value_format,
+        .leaf_value = this -> _leaf_value,
+    });
+    return this -> _function.evaluate({ &leaf, 1 });
+}
 
-        if (this -> _function.getIsAutoreference()) {
-            return GTree::evaluateAutoreference(this -> _function.getOutputType(), (size_t) this -> _leaf_value, this -> _depth_first_index);
+// Node being evaluated, while its children are evaluated
+struct EvaluationFrame {
+    size_t index;
+    // Node evaluated in place of an autoreference, as its only child
+    size_t autoreference_target;
+    size_t next_child;
+    // Evaluated children are moved into the phenotype built by the function
+    SmallVector<enc_phen_t, 4> evaluated_children;
+};
+
+template<typename Fork>
+Result<enc_phen_t> GTree::_evaluateNodes(std::vector<GTree>& nodes, 
+    const std::map<EncodedPhenotypeType, std::vector<GTree::GTreeIndex>>& subexpressions, size_t first_index, size_t root, Fork fork) {
+    std::vector<EvaluationFrame> frames;
+    // Autoreferences are resolved when entered, the first one without target stops the evaluation
+    std::optional<GenomusError> error;
+
+    // Evaluates leaves at once, or pushes the frame of the node
+    const auto enter = [&](size_t index) -> std::optional<enc_phen_t> {
+        GTree& node = nodes[index];
+        const bool autoreference = node._function.getIsAutoreference();
+
+        if (!autoreference && (gfunctionAcceptsNumericParameter(node._function) || node._function.getIsRandom())) {
+            return node._evaluateLeaf();
         }
-        return this -> _function.evaluate({
-            EncodedPhenotype({
-                .type = leafF,
-                .child_type = leafF,
-                .children = std::vector<EncodedPhenotype>(),
-                .to_string = [&](std::vector<std::string>) { return std::to_string(this -> _leaf_value); },
-                .leaf_value = this -> _leaf_value,
-            })
+
+        size_t autoreference_target = 0;
+        if (autoreference) {
+            const Result<GTreeIndex> target = GTree::_autoreferenceTarget(subexpressions, node._function.getOutputType(), 
+                (size_t) node._leaf_value, first_index, node._depth_first_index);
+            if (!target) {
+                error = target.error();
+                return std::nullopt;
+            }
+            autoreference_target = *target;
+        }
+
+        GENOMUS_PROFILE_ENTER(node._function.getNameView(), Profiler::tree_node);
+        EvaluationFrame& frame = frames.emplace_back(EvaluationFrame{ 
+            .index = index, 
+            .autoreference_target = autoreference_target, 
+            .next_child = 0, 
+            .evaluated_children = {},
         });
-    } else if(this -> _function.getIsRandom()) {
-        if (this -> _leaf_value == 0) {
-            auto result = this -> _function.evaluate({});
-            this -> _leaf_value = result.getLeafValue();
-            return result;
+
+        if (!autoreference) {
+            frame.evaluated_children.reserve(node._children.size());
+            if (fork(index, frame.evaluated_children)) frame.next_child = node._children.size();
+        }
+        return std::nullopt;
+    };
+
+    try {
+        std::optional<enc_phen_t> result = enter(root);
+
+        while (!error && !frames.empty()) {
+            EvaluationFrame& frame = frames.back();
+            GTree& node = nodes[frame.index];
+            const bool autoreference = node._function.getIsAutoreference();
+            const size_t children = autoreference ? 1 : node._children.size();
+
+            if (frame.next_child < children) {
+                const size_t child = autoreference ? frame.autoreference_target : (size_t) node._children[frame.next_child];
+                frame.next_child++;
+
+                std::optional<enc_phen_t> evaluated_child = enter(child);
+                if (evaluated_child) frames.back().evaluated_children.push_back(std::move(*evaluated_child));
+                continue;
+            }
+
+            enc_phen_t evaluated = autoreference 
+                ? std::move(frame.evaluated_children[0]) 
+                : node._function.evaluate(frame.evaluated_children);
+            frames.pop_back();
+            GENOMUS_PROFILE_EXIT();
+
+            if (frames.empty()) {
+                result.emplace(std::move(evaluated));
+            } else {
+                frames.back().evaluated_children.push_back(std::move(evaluated));
+            }
+        }
+
+        if (error) {
+            for (size_t k = 0; k < frames.size(); ++k) GENOMUS_PROFILE_EXIT();
+            return *error;
+        }
+        return std::move(*result);
+    } catch (...) {
+        for (size_t k = 0; k < frames.size(); ++k) GENOMUS_PROFILE_EXIT();
+        throw;
+    }
+}
+
+Result<enc_phen_t> GTree::tryEvaluate() {
+    return GTree::_evaluateNodes(tree_nodes, available_subexpressions, this -> _first_index, this -> _depth_first_index, 
+        [](size_t, SmallVector<enc_phen_t, 4>&) { return false; });
+}
+
+enc_phen_t GTree::evaluate() {
+    return this -> tryEvaluate().valueOrThrow();
+}
+
+// Parallel evaluation
+
+struct GTree::ParallelEvaluation {
+    // Static data of the thread that started the evaluation, only read while it runs
+    std::vector<GTree>& nodes;
+    const std::map<EncodedPhenotypeType, std::vector<GTree::GTreeIndex>>& subexpressions;
+    // First node of the evaluated root, which autoreferences of every task resolve from
+    size_t first_index;
+    std::vector<size_t> sizes;
+    TaskPool& pool;
+    size_t min_parallel_size;
+};
+
+// Draws the random leaves reachable from a node in the order evaluate() would. Runs on the calling thread,
+// so the parallel evaluation only reads the tree.
+void GTree::_drawRandomLeaves(size_t index, std::vector<bool>& visited) {
+    const size_t first_index = tree_nodes[index]._first_index;
+    // Children are pushed in reverse, so nodes are visited in the same pre-order as evaluate()
+    std::vector<size_t> pending = { index };
+
+    while (!pending.empty()) {
+        const size_t current = pending.back();
+        pending.pop_back();
+
+        if (visited[current]) continue;
+        visited[current] = true;
+
+        GTree& node = tree_nodes[current];
+
+        if (gfunctionAcceptsNumericParameter(node._function)) {
+            if (node._function.getIsAutoreference()) {
+                pending.push_back(GTree::_autoreferenceTarget(available_subexpressions, node._function.getOutputType(), 
+                    (size_t) node._leaf_value, first_index, node._depth_first_index).valueOrThrow());
+            }
+        } else if (node._function.getIsRandom()) {
+            if (!node._isRandomEvaluated) node._evaluateLeaf();
         } else {
-            return this -> _function.evaluate({enc_phen_t({
-                .type = this -> _function.getOutputType(),
-                .child_type = leafF,
-                .children = {},
-                .to_string = [this](std::vector<std::string> children_strings) { return this -> _function.getName() + "(" + std::to_string(this -> _leaf_value) + ")"; },
-                .leaf_value = this -> _leaf_value,
-            })});
+            for (size_t k = node._children.size(); k-- > 0;) pending.push_back(node._children[k]);
         }
     }
+}
 
-    std::vector<enc_phen_t> evaluated_children;
-    for_each(this -> _children.begin(), this -> _children.end(), 
-        [&](GTree::GTreeIndex child) { 
-            evaluated_children.push_back(child.evaluate()); 
+enc_phen_t GTree::_evaluateParallel(ParallelEvaluation& evaluation, size_t index) {
+    return GTree::_evaluateNodes(evaluation.nodes, evaluation.subexpressions, evaluation.first_index, index, 
+        [&](size_t node_index, SmallVector<enc_phen_t, 4>& evaluated_children) {
+            std::span<const GTree::GTreeIndex> children = evaluation.nodes[node_index]._children;
+            if (children.size() <= 1 || evaluation.sizes[node_index] < evaluation.min_parallel_size) return false;
+
+            std::vector<std::optional<enc_phen_t>> results(children.size());
+            evaluation.pool.forEach(children.size(), [&](size_t k) {
+                // Tasks run on any thread, and their phenotypes are released by another one: they are placed on the heap
+                PhenotypeArena::Scope heap_scope(std::pmr::new_delete_resource());
+                results[k].emplace(GTree::_evaluateParallel(evaluation, children[k]));
+            });
+
+            for (auto& result : results) {
+                evaluated_children.push_back(std::move(*result));
+            }
+            return true;
+        }
+    ).valueOrThrow();
+}
+
+enc_phen_t GTree::GTreeIndex::evaluate(TaskPool& pool, size_t min_parallel_size) const {
+    PhenotypeArena::Scope arena_scope(phenotype_arena);
+
+    std::vector<bool> visited(this -> _index + 1, false);
+    GTree::_drawRandomLeaves(this -> _index, visited);
+
+    // Nodes below each node. Children are always built before their parents
+    std::vector<size_t> sizes(this -> _index + 1);
+    for (size_t k = 0; k < sizes.size(); ++k) {
+        sizes[k] = 1;
+        for (auto child : tree_nodes[k]._children) {
+            sizes[k] = std::min(sizes[k] + sizes[child], std::numeric_limits<size_t>::max() / 2);
         }
-    );
+    }
 
-    return this -> _function.evaluate(evaluated_children);
+    GTree::ParallelEvaluation evaluation = {
+        .nodes = tree_nodes,
+        .subexpressions = available_subexpressions,
+        .first_index = tree_nodes[this -> _index]._first_index,
+        .sizes = std::move(sizes),
+        .pool = pool,
+        .min_parallel_size = min_parallel_size,
+    };
+    return ownedCopy(GTree::_evaluateParallel(evaluation, this -> _index));
 }
 
-std::vector<double> GTree::toNormalizedVector() {
-    std::vector<double> result = {1};
-    double encoded_leaf;
+size_t GTree::normalizedVectorSize() const {
+    size_t size = 0;
+    std::vector<const GTree*> pending = { this };
+
+    while (!pending.empty()) {
+        const GTree& node = *pending.back();
+        pending.pop_back();
+
+        const EncodedPhenotypeType output_type = node._function.getOutputType();
+        // Opening marker, function index and closing marker
+        size += 3;
+
+        if (isEncodedPhenotypeTypeAParameterType(output_type)) {
+            size += 2;
+        } else if (isEncodedPhenotypeTypeAListType(output_type)) {
+            size += 2 * node._children.size();
+        } else if (!node._function.getIsAutoreference()) {
+            for (auto child: node._children) {
+                pending.push_back(&tree_nodes[child]);
+            }
+        }
+    }
 
-    double encoded_index = function_name_to_index[unalias_name(this -> _function.getName())];
-    result.push_back(encoded_index);
+    return size;
+}
 
-    if (isEncodedPhenotypeTypeAParameterType(this -> _function.getOutputType())) {
-        result.push_back(leafTypeToNormalizedValue(this -> _function.getOutputType()));
-        double encoded_leaf;
+// Node being written or printed, while its children are
+struct TraversalFrame {
+    GTree* node;
+    std::span<const GTree::GTreeIndex> children;
+    size_t next_child;
+};
+
+double* GTree::writeNormalizedVector(double* out) {
+    // Writes the opening of a node, and returns the children written after it
+    const auto open = [&](GTree& node) -> std::span<const GTree::GTreeIndex> {
+        const EncodedPhenotypeType output_type = node._function.getOutputType();
+
+        *out++ = 1;
+        *out++ = node._function.getEncodedIndex();
+
+        if (isEncodedPhenotypeTypeAParameterType(output_type)) {
+            *out++ = leafTypeToNormalizedValue(output_type);
+
+            // Same leaf values evaluate would produce, without building the phenotype
+            if (node._function.getIsRandom()) {
+                *out++ = node._isRandomEvaluated ? node._leaf_value : node._evaluateLeaf().getLeafValue();
+            } else if (output_type == paramF) {
+                *out++ = node._leaf_value;
+            } else {
+                *out++ = encodeParameter(output_type, node._leaf_value);
+            }
+        } else if (isEncodedPhenotypeTypeAListType(output_type)) {
+            const EncodedPhenotypeType parameter_type = listToParameterType(output_type);
+            const double leafTypeMarker = leafTypeToNormalizedValue(parameter_type);
 
-        if (this -> _function.getIsRandom()) {
-            encoded_leaf = (this -> _leaf_value == 0) ? this -> evaluate().getLeafValue() : this -> _leaf_value;
-        } else {
-            encoded_leaf = this -> evaluate().getLeafValue();
+            for (auto child: node._children) {
+                *out++ = leafTypeMarker;
+                *out++ = encodeParameter(parameter_type, child.getLeafValue());
+            }
+        } else if (!node._function.getIsAutoreference()) {
+            return node._children;
         }
 
-        result.push_back(encoded_leaf);
-    } else if (isEncodedPhenotypeTypeAListType(this -> _function.getOutputType())) {
-        // result.push_back(integerToNormalized(this -> _children.size()));
-        const double leafTypeMarker = leafTypeToNormalizedValue(listToParameterType(this -> _function.getOutputType()));
-
-        for (auto&& child: this -> _children) {
-            result.push_back(leafTypeMarker);
-            result.push_back(encodeParameter(
-                listToParameterType(this -> _function.getOutputType()), 
-                child.getLeafValue())
-            );
+        return {};
+    };
+
+    std::vector<TraversalFrame> frames = { { .node = this, .children = open(*this), .next_child = 0 } };
+
+    while (!frames.empty()) {
+        TraversalFrame& frame = frames.back();
+
+        if (frame.next_child < frame.children.size()) {
+            GTree& child = tree_nodes[frame.children[frame.next_child++]];
+            frames.push_back({ .node = &child, .children = open(child), .next_child = 0 });
+            continue;
         }
-    } else if (this -> _function.getIsAutoreference()) {
-
-    } else {
-        std::vector<double> evaluated_children;
-        for_each(this -> _children.begin(), this -> _children.end(), 
-            [&](GTree::GTreeIndex child) { 
-                auto&& aux = child.toNormalizedVector();
-                evaluated_children.insert(evaluated_children.end(), aux.begin(), aux.end()); 
-            }
-        );
-        result.insert(result.end(), evaluated_children.begin(), evaluated_children.end());
+
+        *out++ = 0;
+        frames.pop_back();
     }
-    
-    result.push_back(0);
 
+    return out;
+}
+
+std::vector<double> GTree::toNormalizedVector() {
+    std::vector<double> result(this -> normalizedVectorSize());
+    this -> writeNormalizedVector(result.data());
     return result;
 }
 
-std::string GTree::toString() {
-    if (gfunctionAcceptsNumericParameter(this -> _function)) {
-        return this -> _function.buildExplicitForm({Parameter(this -> _leaf_value).toString()});
+void GTree::writeString(std::string& output, ExpressionStyle style) const {
+    ExpressionWriter writer(output, style);
+    std::vector<std::pair<const GTree*, size_t>> frames;
+
+    // Writes parameters and autoreferences at once, or opens the node until its children are written
+    const auto open = [&](const GTree& node) {
+        writer.open(node._function.getExplicitName());
+
+        if (gfunctionAcceptsNumericParameter(node._function)) {
+            writer.value(node._leaf_value);
+            writer.close();
+        } else {
+            frames.push_back({ &node, 0 });
+        }
+    };
+
+    open(*this);
+
+    while (!frames.empty()) {
+        auto& [node, next_child] = frames.back();
+
+        if (next_child < node -> _children.size()) {
+            open(tree_nodes[node -> _children[next_child++]]);
+            continue;
+        }
+
+        writer.close();
+        frames.pop_back();
     }
+}
 
-    std::vector<std::string> string_children;
-    for_each(this -> _children.begin(), this -> _children.end(), [&](GTree::GTreeIndex index) { 
-        string_children.push_back(tree_nodes[index].toString()); 
-    });
-    
-    return this -> _function.buildExplicitForm(string_children);
+std::string GTree::toString(ExpressionStyle style) const {
+    std::string result;
+    this -> writeString(result, style);
+    return result;
 }
 
 
@@ -4,11 +4,21 @@
 #include <functional>
 #include <vector>
 #include <map>
+#include <optional>
+#include <span>
+#include <string_view>
 
 #include "encoded_phenotype.hpp"
+#include "expression_writer.hpp"
 #include "features.hpp"
+#include "result.hpp"
+#include "small_vector.hpp"
+#include "task_pool.hpp"
 #include "utils.hpp"
 
+// Subtrees with fewer nodes are evaluated sequentially by the parallel evaluator
+#define PARALLEL_EVALUATION_MIN_SIZE 1024
+
 /*
     GTree class is the ADT for decoded genotypes. Its instances will hold what is needed
     to instantiate and evaluate a decoded genotype.
@@ -17,6 +27,12 @@
     differences between function nodes and parameter leafs in the function tree.
 
     Instances of GTree are intended to be built at runtime.
+
+    An autoreference evaluates to one of the subexpressions of its type built before it, from the
+    first node of the evaluated tree on. Trees built earlier in the same context are not candidates,
+    so a genotype evaluates the same whatever was built before it, and collect() never changes what
+    an autoreference resolves to. Trees built in an empty context, as the interpreter, batch mode,
+    the server and Population build them, resolve as they always did.
 */
 
 class GTree {
@@ -27,8 +43,20 @@ class GTree {
             size_t _index;
         public:
             GTreeIndex(size_t);
-            enc_phen_t evaluate();
-            std::string toString() const;
+            // The phenotype owns its storage: it is evaluated in GTree::phenotype_arena and copied out of it,
+            // so it outlives clean(), collect() and resets of the arena
+            enc_phen_t evaluate() const;
+            // Same as evaluate, returning bad_autoreference errors positioned at the node of the autoreference
+            Result<enc_phen_t> tryEvaluate() const;
+            // Same as evaluate without the copy: the phenotype is stored in arena and must not outlive its reset,
+            // which clean() and collect() also do for GTree::phenotype_arena
+            enc_phen_t evaluate(PhenotypeArena& arena) const;
+            Result<enc_phen_t> tryEvaluate(PhenotypeArena& arena) const;
+            // Evaluates the children of nodes with at least min_parallel_size nodes below them as parallel tasks.
+            // Random leaves are drawn first, in the order evaluate() draws them, so both produce the same phenotype,
+            // which owns its storage as well.
+            enc_phen_t evaluate(TaskPool&, size_t min_parallel_size = PARALLEL_EVALUATION_MIN_SIZE) const;
+            std::string toString(ExpressionStyle = compact_expression) const;
             operator size_t() const;
             operator std::string() const;
             double getLeafValue() const;
@@ -46,12 +74,16 @@ class GTree {
     */
     class GFunction : public GenomusFeature {
         public:
+        using Signature = SmallVector<EncodedPhenotypeType, 4>;
+        // Arguments are handed over to compute, which may move from them
+        using Compute = std::function<enc_phen_t(std::span<enc_phen_t>)>;
+
         struct GFunctionInitializer {
             std::string name;
             size_t index;
             std::vector<EncodedPhenotypeType> param_types;
             EncodedPhenotypeType output_type;
-            std::function<enc_phen_t(std::vector<enc_phen_t>)> compute;
+            Compute compute;
             bool default_function_for_type;
             bool is_Autoreference;
             bool is_random;
@@ -61,19 +93,28 @@ class GTree {
             // GenomusFeature fields
             std::string _name;
             FeatureType _type;
+            // Name written in expressions: aliases are written as the function they alias
+            std::string _explicit_name;
 
             // GFunction fields
             size_t _index;
-            std::vector<EncodedPhenotypeType> _param_types;
+            // Value of the function in normalized vectors, see encodeIndex
+            double _encoded_index;
+            Signature _param_types;
             EncodedPhenotypeType _output_type;
-            std::function<enc_phen_t(std::vector<enc_phen_t>)> _compute;
+            Compute _compute;
             bool _is_Autoreference;
             bool _is_random;
             bool _default_function_for_type;
 
-            void _assert_parameter_format(const std::vector<enc_phen_t>&) const;
+            // Children types are checked once, when the node is built, so evaluation runs no checks.
+            // Returns the position of the first child not matching its parameter, or of the first missing or extra child.
+            std::optional<size_t> _mismatchingParameter(std::span<const GTreeIndex>) const;
+            std::string _parameterFormatMessage(std::span<const GTreeIndex>, size_t mismatch) const;
         public:
             std::string getName();
+            std::string_view getNameView() const;
+            std::string_view getExplicitName() const;
 
             GFunction();
             GFunction(const GFunction&);
@@ -82,42 +123,111 @@ class GTree {
 
             GFunction alias(std::string alias_name);
 
-            std::vector<EncodedPhenotypeType> getParamTypes() const;
+            std::span<const EncodedPhenotypeType> getParamTypes() const;
             size_t getIndex() const;
+            double getEncodedIndex() const;
             std::string buildExplicitForm(std::vector<std::string>);
 
             EncodedPhenotypeType getOutputType() const;
             bool getIsAutoreference() const;
             bool getIsDefaultForType() const;
             bool getIsRandom() const;
-            enc_phen_t evaluate(const std::vector<enc_phen_t>&) const;
+            enc_phen_t evaluate(std::span<enc_phen_t>) const;
             GTreeIndex operator()(std::initializer_list<GTreeIndex>);
-            GTreeIndex operator()(const std::vector<GTreeIndex>);
+            GTreeIndex operator()(std::span<const GTreeIndex>);
             GTreeIndex operator()(double);
+            // Same as the call operators, returning the error instead of throwing it.
+            // Bad parameters are positioned at the mismatching child, see _mismatchingParameter.
+            Result<GTreeIndex> tryApply(std::span<const GTreeIndex>);
+            Result<GTreeIndex> tryApply(double);
             std::string toString();
     };
     
+    using Children = SmallVector<GTreeIndex, 4>;
+
     private:
         GFunction& _function;
-        std::vector<GTreeIndex> _children;
+        Children _children;
 
         double _leaf_value;
         bool _isRandomEvaluated;
         size_t _depth_first_index;
+        // Lowest index among the nodes of the tree, which are built before it. Autoreferences of an evaluation
+        // choose among the subexpressions from the first index of the evaluated root on, so a root evaluates
+        // the same whatever was built before it.
+        size_t _first_index;
+
+        struct ParallelEvaluation;
+        // Evaluation of the nodes that have no children to evaluate: parameters and random leaves
+        enc_phen_t _evaluateLeaf();
+        // Evaluates the tree below root in post-order, with an explicit stack instead of recursion. Autoreferences
+        // resolve from first_index on. fork(index, evaluated_children) may evaluate every child of a node by other
+        // means, returning true if so.
+        template<typename Fork>
+        static Result<enc_phen_t> _evaluateNodes(std::vector<GTree>& nodes, 
+            const std::map<EncodedPhenotypeType, std::vector<GTreeIndex>>& subexpressions, size_t first_index, size_t root, Fork fork);
+        static Result<GTreeIndex> _autoreferenceTarget(const std::map<EncodedPhenotypeType, std::vector<GTreeIndex>>&, 
+            EncodedPhenotypeType, size_t index, size_t first_index, size_t depth_first_index);
+        static void _drawRandomLeaves(size_t index, std::vector<bool>& visited);
+        static enc_phen_t _evaluateParallel(ParallelEvaluation&, size_t index);
     public:
-        static std::vector<GTree> tree_nodes;
-        static std::map<EncodedPhenotypeType, std::vector<GTree::GTreeIndex>> available_subexpressions;
-        static RandomGenerator RNG;
+        static thread_local std::vector<GTree> tree_nodes;
+        // Storage of the phenotypes GTreeIndex evaluates, released by clean()
+        static thread_local PhenotypeArena phenotype_arena;
+        static thread_local std::map<EncodedPhenotypeType, std::vector<GTree::GTreeIndex>> available_subexpressions;
+        static thread_local RandomGenerator RNG;
+        // The static members above are the per thread context nodes are built and evaluated in, see Context
+        struct Context;
+        // Resolves among every subexpression of the context built before depth_first_index
         static EncodedPhenotype evaluateAutoreference(EncodedPhenotypeType, size_t index, size_t depth_first_index);
         static void registerLastInsertedNodeAsSubexpression();
         static std::string printStaticData();
+        // Releases every node and the phenotype arena, as collect() without roots does. Processes that keep
+        // no tree between inputs, as the interpreter, batch mode and the server, call it after each input.
         static void clean();
+        // Keeps the nodes of roots, along with any node built between the first node of a root and the root,
+        // and releases every other node, along with the phenotype arena. Autoreferences only choose among the
+        // nodes kept, which keep their relative order, so they resolve to the same targets as before.
+        // Roots are remapped in place and any other GTreeIndex of the context becomes invalid.
+        // Returns the number of released nodes.
+        static size_t collect(std::span<GTreeIndex> roots);
 
-        GTree(GFunction&, std::vector<GTreeIndex>, double leaf_value = 0, size_t depth_first_index = 0);
+        GTree(GFunction&, std::span<const GTreeIndex>, double leaf_value = 0, size_t depth_first_index = 0);
+
+        std::span<const GTreeIndex> getChildren() const;
 
         enc_phen_t evaluate();
+        Result<enc_phen_t> tryEvaluate();
+        // The normalized vector is written in a single traversal into a buffer of normalizedVectorSize() values
+        size_t normalizedVectorSize() const;
+        double* writeNormalizedVector(double* out);
         std::vector<double> toNormalizedVector();
-        std::string toString();
+        // Appends the expression of the tree to output, so that buffers can be reused
+        void writeString(std::string& output, ExpressionStyle = compact_expression) const;
+        std::string toString(ExpressionStyle = compact_expression) const;
+};
+
+/*
+    Context holds a separate set of the GTree static data: nodes, subexpressions, phenotype storage and RNG.
+    While a Context::Scope is alive, the context is swapped with the static members, so every GTree
+    operation works on it. Contexts let trees with unrelated lifetimes, like the ones owned by specimens,
+    be built and cleaned independently. GTreeIndex values are only meaningful within their context.
+*/
+struct GTree::Context {
+    std::vector<GTree> tree_nodes;
+    std::map<EncodedPhenotypeType, std::vector<GTree::GTreeIndex>> available_subexpressions;
+    PhenotypeArena phenotype_arena;
+    RandomGenerator RNG;
+
+    class Scope {
+        private:
+            Context& _context;
+        public:
+            Scope(Context&);
+            ~Scope();
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+    };
 };
 
 using dec_gen_t = GTree::GTreeIndex;
@@ -164,6 +274,7 @@ std::string humanReadableNormalizedVector(std::vector<double> v);
 
 extern std::map<EncodedPhenotypeType, dec_gen_t> default_genotypes;
 
+double encodeIndex(size_t index);
 double encodeParameter(EncodedPhenotypeType parameterType, double value);
 double decodeParameter(EncodedPhenotypeType parameterType, double encoded_value);
 
@@ -0,0 +1,178 @@
+#include "distance.hpp"
+#include "errorCodes.hpp"
+#include "species.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <thread>
+
+// Kernels accumulate DISTANCE_LANES independent partial sums, so that compilers can vectorize the reduction
+// without reassociating floating point additions. On x86-64 with GCC they are also built for AVX2 and the
+// best version is selected at load time (not under ThreadSanitizer, whose runtime is not ready for ifunc resolvers).
+#define DISTANCE_LANES 8
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && !defined(__SANITIZE_THREAD__)
+#define DISTANCE_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define DISTANCE_KERNEL
+#endif
+
+DISTANCE_KERNEL
+static double sumOfAbsoluteDifferences(const double* a, const double* b, size_t size) {
+    double lanes[DISTANCE_LANES] = {};
+    size_t k = 0;
+
+    for (; k + DISTANCE_LANES <= size; k += DISTANCE_LANES) {
+        for (size_t lane = 0; lane < DISTANCE_LANES; ++lane) {
+            lanes[lane] += std::fabs(a[k + lane] - b[k + lane]);
+        }
+    }
+
+    double result = 0;
+    for (size_t lane = 0; lane < DISTANCE_LANES; ++lane) result += lanes[lane];
+    for (; k < size; ++k) result += std::fabs(a[k] - b[k]);
+
+    return result;
+}
+
+DISTANCE_KERNEL
+static double sumOfSquaredDifferences(const double* a, const double* b, size_t size) {
+    double lanes[DISTANCE_LANES] = {};
+    size_t k = 0;
+
+    for (; k + DISTANCE_LANES <= size; k += DISTANCE_LANES) {
+        for (size_t lane = 0; lane < DISTANCE_LANES; ++lane) {
+            const double difference = a[k + lane] - b[k + lane];
+            lanes[lane] += difference * difference;
+        }
+    }
+
+    double result = 0;
+    for (size_t lane = 0; lane < DISTANCE_LANES; ++lane) result += lanes[lane];
+    for (; k < size; ++k) result += (a[k] - b[k]) * (a[k] - b[k]);
+
+    return result;
+}
+
+double l1Distance(std::span<const double> a, std::span<const double> b) {
+    return sumOfAbsoluteDifferences(a.data(), b.data(), std::min(a.size(), b.size()));
+}
+
+double l2Distance(std::span<const double> a, std::span<const double> b) {
+    return std::sqrt(sumOfSquaredDifferences(a.data(), b.data(), std::min(a.size(), b.size())));
+}
+
+double normalizedL1Distance(std::span<const double> a, std::span<const double> b) {
+    const size_t longest = std::max(a.size(), b.size());
+    if (!longest) return 0;
+
+    const size_t missing = longest - std::min(a.size(), b.size());
+    return (l1Distance(a, b) + missing) / longest;
+}
+
+double normalizedL2Distance(std::span<const double> a, std::span<const double> b) {
+    const size_t longest = std::max(a.size(), b.size());
+    if (!longest) return 0;
+
+    const size_t missing = longest - std::min(a.size(), b.size());
+    return std::sqrt((sumOfSquaredDifferences(a.data(), b.data(), std::min(a.size(), b.size())) + missing) / longest);
+}
+
+double distance(DistanceMetric metric, std::span<const double> a, std::span<const double> b) {
+    switch (metric) {
+        case l1_distance:
+            return l1Distance(a, b);
+        case l2_distance:
+            return l2Distance(a, b);
+        case normalized_l1_distance:
+            return normalizedL1Distance(a, b);
+        case normalized_l2_distance:
+            return normalizedL2Distance(a, b);
+        default:
+            throw std::runtime_error(ErrorCodes::INVALID_ENUM_VALUE);
+    }
+}
+
+// Smallest number of distances worth a thread of its own
+#define DISTANCE_MIN_CHUNK_SIZE 256
+
+static size_t chunkCount(size_t size, size_t threads) {
+    threads = threads ? threads : std::max<unsigned int>(1, std::thread::hardware_concurrency());
+    return std::min(threads, size / DISTANCE_MIN_CHUNK_SIZE + 1);
+}
+
+std::vector<double> distances(DistanceMetric metric, std::span<const double> query, std::span<const std::span<const double>> others, size_t threads) {
+    std::vector<double> result(others.size());
+
+    parallelChunks(others.size(), chunkCount(others.size(), threads), [&](size_t /*chunk*/, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            result[k] = distance(metric, query, others[k]);
+        }
+    });
+
+    return result;
+}
+
+std::vector<double> phenotypeDistances(DistanceMetric metric, const Population& population, size_t index) {
+    if (!population.isEvaluated()) {
+        throw std::runtime_error(ErrorCodes::INVALID_CALL);
+    }
+
+    std::vector<std::span<const double>> phenotypes(population.size());
+    for (size_t k = 0; k < population.size(); ++k) {
+        phenotypes[k] = population.getPhenotypeVector(k);
+    }
+
+    return distances(metric, population.getPhenotypeVector(index), phenotypes, population.getThreads());
+}
+
+// Event distance
+
+static void collectEventFeatures(const EncodedPhenotype& phenotype, EventFeatures& features) {
+    if (phenotype.getType() != eventF) {
+        for (const auto& child : phenotype.getChildren()) {
+            collectEventFeatures(child, features);
+        }
+        return;
+    }
+
+    const auto& fields = phenotype.getChildren();
+    if (fields.size() != PianoEventLayout::field_count) {
+        throw std::runtime_error(ErrorCodes::INVALID_CALL + ": expected piano events");
+    }
+
+    features.pitches.push_back(fields[PianoEventLayout::offset<midiPitchF>].getLeafValue());
+    features.rhythms.push_back(fields[PianoEventLayout::offset<noteValueF>].getLeafValue());
+}
+
+EventFeatures extractEventFeatures(const EncodedPhenotype& phenotype) {
+    EventFeatures features;
+    collectEventFeatures(phenotype, features);
+    return features;
+}
+
+double eventDistance(const EventFeatures& a, const EventFeatures& b, EventDistanceWeights weights) {
+    const size_t longest = std::max(a.pitches.size(), b.pitches.size());
+    if (!longest) return 0;
+
+    const size_t aligned = std::min(a.pitches.size(), b.pitches.size());
+    const double pitch_distance = sumOfAbsoluteDifferences(a.pitches.data(), b.pitches.data(), aligned);
+    const double rhythm_distance = sumOfAbsoluteDifferences(a.rhythms.data(), b.rhythms.data(), aligned);
+    const double missing = (longest - aligned) * (weights.pitch + weights.rhythm);
+
+    return (weights.pitch * pitch_distance + weights.rhythm * rhythm_distance + missing) / longest;
+}
+
+std::vector<double> eventDistances(const EventFeatures& query, std::span<const EventFeatures> others, EventDistanceWeights weights, size_t threads) {
+    std::vector<double> result(others.size());
+
+    parallelChunks(others.size(), chunkCount(others.size(), threads), [&](size_t /*chunk*/, size_t begin, size_t end) {
+        for (size_t k = begin; k < end; ++k) {
+            result[k] = eventDistance(query, others[k], weights);
+        }
+    });
+
+    return result;
+}
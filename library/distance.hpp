@@ -0,0 +1,55 @@
+#ifndef __GENOMUS_CORE_DISTANCE__
+#define __GENOMUS_CORE_DISTANCE__
+
+#include <span>
+#include <vector>
+
+#include "encoded_phenotype.hpp"
+#include "population.hpp"
+
+/*
+    Distances between phenotypes, for novelty search and diversity maintenance.
+
+    Vector metrics work on normalized vectors such as the ones returned by EncodedPhenotype::toNormalizedVector
+    or stored by Population. Plain L1 and L2 distances only compare the aligned prefix of both vectors.
+    Length normalized distances count every value missing from the shorter vector as a difference of 1,
+    the largest difference between normalized values, and divide by the length of the longer vector.
+*/
+enum DistanceMetric {
+    l1_distance,
+    l2_distance,
+    normalized_l1_distance,
+    normalized_l2_distance,
+};
+
+double l1Distance(std::span<const double>, std::span<const double>);
+double l2Distance(std::span<const double>, std::span<const double>);
+double normalizedL1Distance(std::span<const double>, std::span<const double>);
+double normalizedL2Distance(std::span<const double>, std::span<const double>);
+double distance(DistanceMetric, std::span<const double>, std::span<const double>);
+
+// Distances from query to every vector in others, computed in parallel. threads = 0 uses every hardware thread
+std::vector<double> distances(DistanceMetric, std::span<const double> query, std::span<const std::span<const double>> others, size_t threads = 0);
+// Distances from the phenotype of a specimen to the phenotypes of the whole population, which must be evaluated
+std::vector<double> phenotypeDistances(DistanceMetric, const Population&, size_t index);
+
+/*
+    Event wise distance for the piano species. Events are compared in order by pitch and rhythm (note value),
+    weighted by the given weights. Unmatched events count as the largest difference, and the sum is divided by
+    the event count of the longest phenotype.
+*/
+struct EventFeatures {
+    std::vector<double> pitches;
+    std::vector<double> rhythms;
+};
+
+struct EventDistanceWeights {
+    double pitch = 0.5;
+    double rhythm = 0.5;
+};
+
+EventFeatures extractEventFeatures(const EncodedPhenotype&);
+double eventDistance(const EventFeatures&, const EventFeatures&, EventDistanceWeights weights = {});
+std::vector<double> eventDistances(const EventFeatures& query, std::span<const EventFeatures> others, EventDistanceWeights weights = {}, size_t threads = 0);
+
+#endif
@@ -2,14 +2,20 @@
 #include "decoded_genotype.hpp"
 #include "encoded_phenotype.hpp"
 #include "errorCodes.hpp"
+#include "expression_writer.hpp"
+#include "function_selection_table.hpp"
+#include "result.hpp"
 #include "utils.hpp"
 
+#include <cstdint>
 #include <iostream>
 #include <ostream>
 #include <random>
+#include <span>
 #include <stack>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 static const unsigned int MAX_RANDOM_VECTOR_LENGTH = 128;
 
@@ -39,6 +45,7 @@ std::vector<double> newGerminalVector() {
 enum RetroTranscriptionStates {
     start,
     function_index,
+    function_parameters,
     leaf_indentifier,
     leaf_value,
     end,
@@ -50,69 +57,68 @@ static const VectorNormalizationState default_vector_normalization_state = {
     .current_depth = 0,
 };
 
-double getClosestFunctionIndex(FunctionTypeDictionary& dictionary, EncodedPhenotypeType type, double value, bool include_autoreferences) {
-    // Can return an autoreference function only if there are available subexpressions available.
-    double current_function_index = getClosestValue(dictionary[type], value);
-
-    if (autoreference_type_dictionary[type] == current_function_index && !include_autoreferences) {
-        current_function_index = getClosestValue(dictionary[type], value, true);
-    }
+// Node of the retrotranscription being visited. Nested functions are visited with an explicit stack of
+// frames instead of recursion, so that deep vectors cannot overflow the call stack.
+struct RetroTranscriptionFrame {
+    VectorNormalizationState state;
+    RetroTranscriptionStates machine_state;
+    // Computed when the node is entered, so it selects the dictionary for the whole node
+    bool limits_overpassed;
+    std::span<const EncodedPhenotypeType> parameters;
+    size_t next_parameter;
+};
 
-    return current_function_index;
+static RetroTranscriptionFrame newRetroTranscriptionFrame(VectorNormalizationState state, size_t position) {
+    return {
+        .state = state,
+        .machine_state = start,
+        .limits_overpassed = state.current_depth > MAX_GENOTYPE_DEPTH || position > MAX_GENOTYPE_VECTOR_SIZE,
+        .parameters = {},
+        .next_parameter = 0,
+    };
 }
 
-void innerNormalizeVector(const std::vector<double>& input, std::vector<double>& output, VectorNormalizationState state) {
+// Input must not be empty, since the retrotranscription wraps around it
+static void innerNormalizeVector(const std::vector<double>& input, std::vector<double>& output, VectorNormalizationState state) {
     double current_function_index;
-    RetroTranscriptionStates machine_state = start;
-    static size_t position = 0;
-    static std::vector<EncodedPhenotypeType> autoreferenciable_types = {};
-
-    if (state.current_depth == 0) {
-        position = 0;
-        autoreferenciable_types = {};
-    }
-    
-    static size_t read_position = position % input.size();
-
-    std::vector<EncodedPhenotypeType> current_function_parameters;
-
-    bool ready = false;
-    bool current_function_has_children;
+    size_t position = 0;
+    size_t read_position = 0;
+    std::vector<EncodedPhenotypeType> autoreferenciable_types = {};
 
     const auto advance = [&]() {
-        if (input.size() == 0) {
-            throw std::runtime_error("xxx");
-        }
         position++;
         read_position = position % input.size();
     };
 
-    bool limits_overpassed = state.current_depth > MAX_GENOTYPE_DEPTH || position > MAX_GENOTYPE_VECTOR_SIZE;
-    FunctionTypeDictionary& dictionary = limits_overpassed ? default_function_type_dictionary : function_type_dictionary;
+    std::vector<RetroTranscriptionFrame> frames = { newRetroTranscriptionFrame(state, position) };
 
-    while (!ready) {
-        switch (machine_state) {
+    while (!frames.empty()) {
+        RetroTranscriptionFrame& frame = frames.back();
+
+        switch (frame.machine_state) {
             case start:
                 output.push_back(1);
-                machine_state = function_index;
+                frame.machine_state = function_index;
                 advance();
                 break;
-            case function_index:
+            case function_index: {
+                const FunctionSelectionTable& selection_table = frame.limits_overpassed ? default_function_selection_table : function_selection_table;
+
                 // Find closest type-conforming index
-                current_function_index = getClosestFunctionIndex(dictionary, state.output_type, input[read_position], includes(autoreferenciable_types, state.output_type));
+                current_function_index = selection_table.select(frame.state.output_type, input[read_position], includes(autoreferenciable_types, frame.state.output_type));
                 output.push_back(current_function_index);
                 advance();
 
-                current_function_parameters = available_functions[current_function_index].getParamTypes();
+                frame.machine_state = end;
 
-                if (isEncodedPhenotypeTypeAParameterType(state.output_type) && !available_functions[current_function_index].getIsRandom()) {
+                if (isEncodedPhenotypeTypeAParameterType(frame.state.output_type) && !available_functions.at(current_function_index).getIsRandom()) {
                     // Go for leaf parameter
-                    output.push_back(leafTypeToNormalizedValue(state.output_type));
+                    output.push_back(leafTypeToNormalizedValue(frame.state.output_type));
                     advance();
                     output.push_back(input[read_position]);
                     advance();
-                } else if (isEncodedPhenotypeTypeAListType(state.output_type)) {
-                    const double leafTypeMarker = leafTypeToNormalizedValue(listToParameterType(state.output_type));
+                } else if (isEncodedPhenotypeTypeAListType(frame.state.output_type)) {
+                    const double leafTypeMarker = leafTypeToNormalizedValue(listToParameterType(frame.state.output_type));
                     size_t list_size = 0;
 
                     // Go for list parameters
@@ -124,24 +130,31 @@ void innerNormalizeVector(const std::vector<double>& input, std::vector<double>&
                         list_size++;
                         if (input[read_position] < LIST_EXTENSION_THRESHOLD) break;
                     } while (list_size < MAX_LIST_SIZE);
-                } else if (current_function_parameters.size()) {
+                } else {
                     // Explore parameter types and compute parameters on output
-                    for (auto parameterType : current_function_parameters) {
-                        innerNormalizeVector(input, output, {
-                            .output_type = parameterType,
-                            .current_depth = state.current_depth + 1,
-                        });
-                    }
+                    frame.parameters = available_functions.at(current_function_index).getParamTypes();
+                    frame.machine_state = function_parameters;
+                }
+                break;
+            }
+            case function_parameters:
+                // Parameters are visited in order, one frame each
+                if (frame.next_parameter < frame.parameters.size()) {
+                    const VectorNormalizationState parameter_state = {
+                        .output_type = frame.parameters[frame.next_parameter++],
+                        .current_depth = frame.state.current_depth + 1,
+                    };
+                    frames.push_back(newRetroTranscriptionFrame(parameter_state, position));
+                } else {
+                    frame.machine_state = end;
                 }
-
-                machine_state = end;
                 break;
             case end:
                 output.push_back(0);
-                ready = true;
 
-                autoreferenciable_types.push_back(state.output_type);
+                autoreferenciable_types.push_back(frame.state.output_type);
                 advance();
+                frames.pop_back();
                 break;
             default:
                 throw std::runtime_error(ErrorCodes::INVALID_ENUM_VALUE);
@@ -149,129 +162,177 @@ void innerNormalizeVector(const std::vector<double>& input, std::vector<double>&
     }
 }
 
-void normalizeVector(const std::vector<double>& input, std::vector<double>& output) {
+Result<size_t> tryNormalizeVector(const std::vector<double>& input, std::vector<double>& output) {
+    if (input.empty()) {
+        return GenomusError{ .code = ErrorCodes::empty_germinal_vector, .position = 0, .function = {} };
+    }
+
+    const size_t initial_size = output.size();
     innerNormalizeVector(input, output, default_vector_normalization_state);
+    return output.size() - initial_size;
+}
+
+void normalizeVector(const std::vector<double>& input, std::vector<double>& output) {
+    tryNormalizeVector(input, output).valueOrThrow();
 }
 
-std::string innerToExpression(const std::vector<double>& input, VectorNormalizationState state) {
+// Runs the retrotranscription automaton over a normalized vector, writing its expression unless validating.
+// Validation also requires exact function indices, autoreferences to earlier nodes as normalizeVector
+// allows them, and a vector holding the genotype and nothing else. Expressions wrap around the vector instead.
+template<bool validate>
+static Result<size_t> innerToExpression(std::span<const double> input, ExpressionWriter* writer, VectorNormalizationState state) {
     // Code mostly reused from normalizeVector. Probably it is possible to unify the two functions.
+    static_assert(harmonyF < 64, "Closed types are kept in a 64 bit mask");
 
     double current_function_index;
-    RetroTranscriptionStates machine_state = start;
-    static size_t position = 0;
-    static std::string result = "";
+    size_t position = 0;
+    size_t read_position = 0;
+    // Types of the nodes closed so far, which autoreferences may refer to
+    uint64_t closed_types = 0;
 
-    if (state.current_depth == 0) {
-        position = 0;
-        result = "";
+    if (input.empty()) {
+        return GenomusError{ .code = ErrorCodes::bad_normalized_vector_opening_marker, .position = 0, .function = {} };
     }
-    
-    static size_t read_position = position % input.size();
 
-    std::vector<EncodedPhenotypeType> current_function_parameters;
-
-    bool ready = false;
-    bool current_function_has_children;
-
-    static const auto advance = [&]() {
+    const auto advance = [&]() {
         position++;
-        read_position = position % input.size();
+        read_position = validate ? position : position % input.size();
+    };
+    const auto failure = [&](ErrorCodes::ErrorCode code) -> GenomusError {
+        return { 
+            .code = read_position < input.size() ? code : ErrorCodes::bad_normalized_vector_truncated, 
+            .position = read_position, 
+            .function = {},
+        };
     };
 
-    bool limits_overpassed = state.current_depth > MAX_GENOTYPE_DEPTH || position > MAX_GENOTYPE_VECTOR_SIZE;
-    FunctionTypeDictionary& dictionary = limits_overpassed ? default_function_type_dictionary : function_type_dictionary;
+    std::vector<RetroTranscriptionFrame> frames = { newRetroTranscriptionFrame(state, position) };
+
+    while (!frames.empty()) {
+        RetroTranscriptionFrame& frame = frames.back();
 
-    while (!ready) {
-        switch (machine_state) {
+        if (read_position >= input.size()) return failure(ErrorCodes::bad_normalized_vector_truncated);
+
+        switch (frame.machine_state) {
             case start:
-                if (input[read_position] != 1.0) {
-                    throw std::runtime_error("Expected 1.0 at position " + std::to_string(read_position));
-                }
-                machine_state = function_index;
+                if (input[read_position] != 1.0) return failure(ErrorCodes::bad_normalized_vector_opening_marker);
+                frame.machine_state = function_index;
                 advance();
                 break;
-            case function_index:
+            case function_index: {
+                const FunctionSelectionTable& selection_table = frame.limits_overpassed ? default_function_selection_table : function_selection_table;
+                const bool include_autoreferences = !validate || (closed_types >> frame.state.output_type) & 1;
+
                 // Find closest type-conforming index
-                current_function_index = getClosestFunctionIndex(dictionary, state.output_type, input[read_position], true);
-                result += available_functions[current_function_index].getName() + "(";
+                current_function_index = selection_table.select(frame.state.output_type, input[read_position], include_autoreferences);
+                if (validate && current_function_index != input[read_position]) return failure(ErrorCodes::bad_normalized_vector_function_index);
+
+                const GTree::GFunction& function = available_functions.at(current_function_index);
+                if constexpr (!validate) writer -> open(function.getNameView());
                 advance();
 
-                current_function_parameters = available_functions[current_function_index].getParamTypes();
+                frame.machine_state = end;
 
-                if (isEncodedPhenotypeTypeAParameterType(state.output_type) && !available_functions[current_function_index].getIsRandom()) {
+                if (isEncodedPhenotypeTypeAParameterType(frame.state.output_type) && !function.getIsRandom()) {
                     // Go for leaf parameter
-                    if (input[read_position] != leafTypeToNormalizedValue(state.output_type)) {
-                        throw std::runtime_error("Expected formatted parameter type at position " + std::to_string(read_position));
+                    if (read_position >= input.size() || input[read_position] != leafTypeToNormalizedValue(frame.state.output_type)) {
+                        return failure(ErrorCodes::bad_normalized_vector_leaf_type_marker);
                     }
                     advance();
-                    const double decoded_leaf = decodeParameter(state.output_type, input[read_position]);
-                    result += std::to_string(decoded_leaf);
+                    if (read_position >= input.size()) return failure(ErrorCodes::bad_normalized_vector_truncated);
+                    if constexpr (!validate) writer -> value(decodeParameter(frame.state.output_type, input[read_position]));
                     advance();
-                } else if (isEncodedPhenotypeTypeAListType(state.output_type)) {
-                    const double leafTypeMarker = leafTypeToNormalizedValue(listToParameterType(state.output_type));
-                    const double associated_parameter_function_index = 
-                        default_function_type_dictionary[listToParameterType(state.output_type)][0];
-                    const std::string associated_parameter_function_name = 
-                        available_functions[associated_parameter_function_index].getName();
+                } else if (isEncodedPhenotypeTypeAListType(frame.state.output_type)) {
+                    const EncodedPhenotypeType parameter_type = listToParameterType(frame.state.output_type);
+                    const double leafTypeMarker = leafTypeToNormalizedValue(parameter_type);
+                    const double associated_parameter_function_index = default_function_type_dictionary.at(parameter_type)[0];
+                    const std::string_view associated_parameter_function_name = 
+                        available_functions.at(associated_parameter_function_index).getNameView();
                     size_t list_size = 0;
 
                     // Go for list parameters
                     do {
-                        if (input[read_position] != leafTypeMarker) {
-                            throw std::runtime_error("Expected formatted parameter type at position " + std::to_string(read_position));
+                        if (read_position >= input.size() || input[read_position] != leafTypeMarker) {
+                            return failure(ErrorCodes::bad_normalized_vector_leaf_type_marker);
                         }
                         advance();
-                        const double decoded_leaf = decodeParameter(listToParameterType(state.output_type), input[read_position]);
-                        result += associated_parameter_function_name + "(" + std::to_string(decoded_leaf) + ")" + ", ";
+                        if (read_position >= input.size()) return failure(ErrorCodes::bad_normalized_vector_truncated);
+                        if constexpr (!validate) {
+                            writer -> open(associated_parameter_function_name);
+                            writer -> value(decodeParameter(parameter_type, input[read_position]));
+                            writer -> close();
+                        }
                         advance();
                         list_size++;
 
-                        if (input[read_position] < LIST_EXTENSION_THRESHOLD){
-                            result = result.substr(0, result.length() - 2);
-                            break;
-                        }
+                        if (read_position >= input.size()) return failure(ErrorCodes::bad_normalized_vector_truncated);
+                        if (input[read_position] < LIST_EXTENSION_THRESHOLD) break;
                     } while (list_size < MAX_LIST_SIZE);
-                } else if (current_function_parameters.size()) {
+                } else {
                     // Explore parameter types and compute parameters on output
-                    for (auto parameterType : current_function_parameters) {
-                        innerToExpression(input, {
-                            .output_type = parameterType,
-                            .current_depth = state.current_depth + 1,
-                        });
-                        result += ", ";
-                    }
-
-                    result = result.substr(0, result.size() - 2);
+                    frame.parameters = function.getParamTypes();
+                    frame.machine_state = function_parameters;
                 }
-
-                machine_state = end;
                 break;
-            case end:
-                if (input[read_position] != 0) {
-                    throw std::runtime_error("Expected 0 at position " + std::to_string(read_position));
+            }
+            case function_parameters:
+                // Parameters are visited in order, one frame each
+                if (frame.next_parameter < frame.parameters.size()) {
+                    const VectorNormalizationState parameter_state = {
+                        .output_type = frame.parameters[frame.next_parameter++],
+                        .current_depth = frame.state.current_depth + 1,
+                    };
+                    frames.push_back(newRetroTranscriptionFrame(parameter_state, position));
+                } else {
+                    frame.machine_state = end;
                 }
-                result += ")";
-                ready = true;
+                break;
+            case end:
+                if (input[read_position] != 0) return failure(ErrorCodes::bad_normalized_vector_closing_marker);
+                if constexpr (!validate) writer -> close();
+                closed_types |= (uint64_t) 1 << frame.state.output_type;
                 advance();
+                frames.pop_back();
                 break;
             default:
                 throw std::runtime_error(ErrorCodes::INVALID_ENUM_VALUE);
         }
     }
 
-    try {
-        if (result == "") {
-            throw std::runtime_error("Something went wrong");
-        }
+    if (validate && position != input.size()) return failure(ErrorCodes::bad_normalized_vector_trailing_values);
 
-    } catch (std::runtime_error e) {
+    return position;
+}
 
-    }
+Result<size_t> validateNormalizedVector(std::span<const double> input) {
+    return innerToExpression<true>(input, nullptr, default_vector_normalization_state);
+}
+
+Result<size_t> tryToExpression(std::span<const double> input, std::string& output) {
+    const size_t initial_size = output.size();
+    // Expressions of random genotypes take about EXPRESSION_CHARACTERS_PER_VALUE characters per vector value
+    output.reserve(initial_size + EXPRESSION_CHARACTERS_PER_VALUE * input.size());
 
+    ExpressionWriter writer(output);
+    Result<size_t> result = 0;
 
+    try {
+        result = innerToExpression<false>(input, &writer, default_vector_normalization_state);
+    } catch (...) {
+        output.resize(initial_size);
+        throw;
+    }
+
+    if (!result) output.resize(initial_size);
     return result;
 }
 
+void toExpression(const std::vector<double>& input, std::string& output) {
+    tryToExpression(input, output).valueOrThrow();
+}
+
 std::string toExpression(const std::vector<double>& input) {
-    return innerToExpression(input, default_vector_normalization_state);
-}
\ No newline at end of file
+    std::string result;
+    toExpression(input, result);
+    return result;
+}
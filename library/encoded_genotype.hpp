@@ -1,15 +1,19 @@
 #ifndef __GENOMUS_CORE_ENCODED_GENOTYPE__
 #define __GENOMUS_CORE_ENCODED_GENOTYPE__ 
 
+#include <span>
+#include <string>
 #include <vector>
 #include "decoded_genotype.hpp"
 #include "encoded_phenotype.hpp"
+#include "result.hpp"
 
 #define GERMINAL_VECTOR_MAX_LENGTH 256
 #define MAX_GENOTYPE_VECTOR_SIZE 10000
 #define MAX_GENOTYPE_DEPTH 256
 #define MAX_LIST_SIZE 256
 #define LIST_EXTENSION_THRESHOLD std::min(0.5, 1.0 / (double)MAX_LIST_SIZE)
+#define EXPRESSION_CHARACTERS_PER_VALUE 7
 
 // Generate a random vector of size n
 std::vector<double> randomVector(int n);
@@ -25,7 +29,18 @@ struct VectorNormalizationState {
 };
 
 void normalizeVector(const std::vector<double>& input, std::vector<double>& output);
+// Same as normalizeVector, returning the number of values appended to output. Empty inputs are an empty_germinal_vector error.
+Result<size_t> tryNormalizeVector(const std::vector<double>& input, std::vector<double>& output);
+// Checks a normalized vector against the current function library without building anything. Besides the markers
+// toExpression checks, function indices must be exact indices of their type, autoreferences must be as
+// normalizeVector produces them and the vector must end with the genotype.
+// Returns the size of a well-formed vector, or the error found at the first value breaking the grammar.
+Result<size_t> validateNormalizedVector(std::span<const double> input);
 std::string toExpression(const std::vector<double>& input);
+// Appends the expression to output, so that buffers can be reused. Output is left as it was on errors.
+void toExpression(const std::vector<double>& input, std::string& output);
+// Same as toExpression, returning the number of values read or the error found at a value of the vector
+Result<size_t> tryToExpression(std::span<const double> input, std::string& output);
 // dec_gen_t toDecodedGenotype(const std::vector<double>& input);
 
 class EncodedGenotype {
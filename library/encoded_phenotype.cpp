@@ -6,7 +6,6 @@
 #include "decoded_genotype.hpp"
 #include "encoded_phenotype.hpp"
 #include "errorCodes.hpp"
-#include "species.hpp"
 #include "utils.hpp"
 
 #define ENCODED_PHENOTYPES_TYPE_CHECK
@@ -62,65 +61,271 @@ std::string encodedPhenotypeTypeToString(const EncodedPhenotypeType& ept) {
     }
 }
 
-EncodedPhenotype::EncodedPhenotype(EncodedPhenotype::EncodedPhenotypeInitializer init) {
+// PhenotypeArena
+
+void* PhenotypeArena::UpstreamCounter::do_allocate(size_t bytes, size_t alignment) {
+    this -> allocated_bytes += bytes;
+    return std::pmr::new_delete_resource() -> allocate(bytes, alignment);
+}
+
+void PhenotypeArena::UpstreamCounter::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    std::pmr::new_delete_resource() -> deallocate(p, bytes, alignment);
+}
+
+bool PhenotypeArena::UpstreamCounter::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+static std::pmr::memory_resource* blockResource(std::pmr::memory_resource* small_blocks, size_t bytes) {
+    return bytes > PHENOTYPE_ARENA_MAX_BLOCK_SIZE ? std::pmr::new_delete_resource() : small_blocks;
+}
+
+void* PhenotypeArena::BlockRouter::do_allocate(size_t bytes, size_t alignment) {
+    return blockResource(this -> small_blocks, bytes) -> allocate(bytes, alignment);
+}
+
+void PhenotypeArena::BlockRouter::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    blockResource(this -> small_blocks, bytes) -> deallocate(p, bytes, alignment);
+}
+
+bool PhenotypeArena::BlockRouter::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+PhenotypeArena::PhenotypeArena(size_t initial_size) : _storage(std::make_unique<Storage>()) {
+    this -> _storage -> buffer_size = initial_size;
+    this -> _storage -> buffer = std::make_unique_for_overwrite<std::byte[]>(initial_size);
+    this -> _emplaceResources();
+}
+
+void PhenotypeArena::_emplaceResources() {
+    Storage& storage = *this -> _storage;
+    storage.resource.emplace(storage.buffer.get(), storage.buffer_size, &storage.upstream);
+    this -> _emplacePool();
+}
+
+void PhenotypeArena::_emplacePool() {
+    Storage& storage = *this -> _storage;
+    storage.pool.emplace(&*storage.resource);
+    storage.router.small_blocks = &*storage.pool;
+}
+
+std::pmr::memory_resource* PhenotypeArena::resource() { return &this -> _storage -> router; }
+
+void PhenotypeArena::reset() {
+    Storage& storage = *this -> _storage;
+    storage.pool.reset();
+
+    if (storage.upstream.allocated_bytes == 0) {
+        storage.resource -> release();
+        this -> _emplacePool();
+        return;
+    }
+
+    // The cycle did not fit in the buffer: grow it to the high water mark
+    storage.resource.reset();
+    storage.buffer_size += storage.upstream.allocated_bytes;
+    storage.upstream.allocated_bytes = 0;
+    storage.buffer = std::make_unique_for_overwrite<std::byte[]>(storage.buffer_size);
+    this -> _emplaceResources();
+}
+
+size_t PhenotypeArena::capacity() const { return this -> _storage -> buffer_size + this -> _storage -> upstream.allocated_bytes; }
+
+void PhenotypeArena::swap(PhenotypeArena& other) noexcept { this -> _storage.swap(other._storage); }
+
+static thread_local std::pmr::memory_resource* current_phenotype_resource = std::pmr::new_delete_resource();
+
+std::pmr::memory_resource* PhenotypeArena::current() { return current_phenotype_resource; }
+
+PhenotypeArena::Scope::Scope(PhenotypeArena& arena) {
+    this -> _previous = current_phenotype_resource;
+    current_phenotype_resource = arena.resource();
+}
+
+PhenotypeArena::Scope::Scope(std::pmr::memory_resource* resource) {
+    this -> _previous = current_phenotype_resource;
+    current_phenotype_resource = resource;
+}
+
+PhenotypeArena::Scope::~Scope() { current_phenotype_resource = this -> _previous; }
+
+// EncodedPhenotype
+
+EncodedPhenotype::EncodedPhenotype(EncodedPhenotype::EncodedPhenotypeInitializer init) 
+    : _children(std::move(init.children), PhenotypeArena::current()) {
     this -> _type = init.type;
     this -> _child_type = init.child_type;
-    this -> _children = init.children;
-    this -> _to_string = init.to_string;
+    this -> _label = init.label;
+    this -> _format = init.format;
     this -> _leaf_value = init.leaf_value;
 }
 
-EncodedPhenotypeType EncodedPhenotype::getType() { return this -> _type; }
-EncodedPhenotypeType EncodedPhenotype::getChildType() { return this -> _child_type; }
-std::string EncodedPhenotype::toString() { 
-    std::vector<std::string> children_strings;
-    for (auto child: this -> _children) {
-        children_strings.push_back(child.toString());
+EncodedPhenotype::EncodedPhenotype(const EncodedPhenotype& other)
+    : _children(other._children, std::pmr::new_delete_resource()) {
+    this -> _type = other._type;
+    this -> _child_type = other._child_type;
+    this -> _label = other._label;
+    this -> _format = other._format;
+    this -> _leaf_value = other._leaf_value;
+}
+
+EncodedPhenotypeType EncodedPhenotype::getType() const { return this -> _type; }
+EncodedPhenotypeType EncodedPhenotype::getChildType() const { return this -> _child_type; }
+void EncodedPhenotype::writeString(std::string& output, ExpressionStyle style) const {
+    ExpressionWriter writer(output, style);
+    std::vector<std::pair<const EncodedPhenotype*, size_t>> frames;
+
+    // Writes values at once, or opens the phenotype until its children are written
+    const auto open = [&](const EncodedPhenotype& phenotype) {
+        switch (phenotype._format) {
+            case value_format:
+                writer.value(phenotype._leaf_value);
+                break;
+            case labelled_value_format:
+                writer.open(phenotype._label);
+                writer.value(phenotype._leaf_value);
+                writer.close();
+                break;
+            case labelled_children_format:
+                writer.open(phenotype._label);
+                frames.push_back({ &phenotype, 0 });
+                break;
+            default:
+                throw std::runtime_error(ErrorCodes::INVALID_ENUM_VALUE);
+        }
+    };
+
+    open(*this);
+
+    while (!frames.empty()) {
+        auto& [phenotype, next_child] = frames.back();
+
+        if (next_child < phenotype -> _children.size()) {
+            open(phenotype -> _children[next_child++]);
+            continue;
+        }
+
+        writer.close();
+        frames.pop_back();
     }
-    return this -> _to_string(children_strings); 
 }
 
-const std::vector<EncodedPhenotype>& EncodedPhenotype::getChildren() { return this -> _children; }
+std::string EncodedPhenotype::toString(ExpressionStyle style) const { 
+    std::string result;
+    this -> writeString(result, style);
+    return result;
+}
+
+const EncodedPhenotype::Children& EncodedPhenotype::getChildren() const { return this -> _children; }
 
-double EncodedPhenotype::getLeafValue() { return this -> _leaf_value; }
+EncodedPhenotype::Children EncodedPhenotype::takeChildren() { return std::move(this -> _children); }
+
+void EncodedPhenotype::appendChildren(Children&& children) {
+    // Grow geometrically: repeated concatenations must not reallocate on every call
+    const size_t required = this -> _children.size() + children.size();
+    if (required > this -> _children.capacity()) {
+        this -> _children.reserve(std::max(required, 2 * this -> _children.capacity()));
+    }
+    std::move(children.begin(), children.end(), std::back_inserter(this -> _children));
+}
+
+double EncodedPhenotype::getLeafValue() const { return this -> _leaf_value; }
 
 bool shouldIncludeChildrenSize(EncodedPhenotypeType type) {
-    return includes({scoreF, voiceF}, type) || includes(listTypes, type);
+    return type == scoreF || type == voiceF || isEncodedPhenotypeTypeAListType(type);
 }
 
-std::vector<double> EncodedPhenotype::toNormalizedVector() const {
-    if (includes(parameterTypes, this -> _type)) {
-        return { this -> _leaf_value };
+size_t EncodedPhenotype::normalizedVectorSize() const {
+    size_t size = 0;
+    std::vector<const EncodedPhenotype*> pending = { this };
+
+    while (!pending.empty()) {
+        const EncodedPhenotype& phenotype = *pending.back();
+        pending.pop_back();
+
+        if (includes(parameterTypes, phenotype._type)) {
+            size += 1;
+            continue;
+        }
+
+        // List items are preceded by their leaf type marker
+        size += shouldIncludeChildrenSize(phenotype._type) + isEncodedPhenotypeTypeAListType(phenotype._type) * phenotype._children.size();
+        for (auto& child: phenotype._children) {
+            pending.push_back(&child);
+        }
     }
 
-    std::vector<double> result;
-    std::vector<double> evaluated_children;
-
-    static const auto 
-        encodeAndAddChildren = [&](std::vector<double>& inner_result, const std::vector<EncodedPhenotype>& children) -> void {
-            for_each(children.begin(), children.end(), [&](const EncodedPhenotype& ept) {
-                if (isEncodedPhenotypeTypeAListType(this -> _type)){
-                    inner_result += leafTypeToNormalizedValue(listToParameterType(this -> _type));
-                }
-                inner_result += ept.toNormalizedVector();
-            });
-        };
-
-    if (shouldIncludeChildrenSize(this -> _type)) {
-        result = { integerToNormalized(this -> _children.size()) };
+    return size;
+}
+
+double* EncodedPhenotype::writeNormalizedVector(double* out) const {
+    // Phenotypes still to be written, along with the leaf type marker preceding list items
+    struct Pending {
+        const EncodedPhenotype* phenotype;
+        double leaf_type_marker;
+    };
+    // Children are pushed in reverse, so they are written in order
+    std::vector<Pending> pending = { { .phenotype = this, .leaf_type_marker = 0 } };
+
+    while (!pending.empty()) {
+        const Pending current = pending.back();
+        const EncodedPhenotype& phenotype = *current.phenotype;
+        pending.pop_back();
+
+        if (current.leaf_type_marker) {
+            *out++ = current.leaf_type_marker;
+        }
+
+        if (includes(parameterTypes, phenotype._type)) {
+            *out++ = phenotype._leaf_value;
+            continue;
+        }
+
+        if (shouldIncludeChildrenSize(phenotype._type)) {
+            *out++ = encodeInteger(phenotype._children.size());
+        }
+
+        const bool is_list = isEncodedPhenotypeTypeAListType(phenotype._type);
+        const double leaf_type_marker = is_list ? leafTypeToNormalizedValue(listToParameterType(phenotype._type)) : 0;
+
+        for (size_t k = phenotype._children.size(); k-- > 0;) {
+            pending.push_back({ .phenotype = &phenotype._children[k], .leaf_type_marker = leaf_type_marker });
+        }
     }
-    
-    encodeAndAddChildren(result, this -> _children);
 
+    return out;
+}
+
+void EncodedPhenotype::appendNormalizedVector(std::vector<double>& out) const {
+    const size_t offset = out.size();
+    out.resize(offset + this -> normalizedVectorSize());
+    this -> writeNormalizedVector(out.data() + offset);
+}
+
+std::vector<double> EncodedPhenotype::toNormalizedVector() const {
+    std::vector<double> result(this -> normalizedVectorSize());
+    this -> writeNormalizedVector(result.data());
     return result;
 }
 
+EncodedPhenotype::Children toChildren(std::vector<EncodedPhenotype>&& v) {
+    return toChildren(std::span<EncodedPhenotype>(v));
+}
+
+EncodedPhenotype::Children toChildren(std::span<EncodedPhenotype> v) {
+    EncodedPhenotype::Children children(PhenotypeArena::current());
+    children.reserve(v.size());
+    std::move(v.begin(), v.end(), std::back_inserter(children));
+    return children;
+}
+
 EncodedPhenotype Parameter(double value) {
     return EncodedPhenotype({
         .type = paramF, // ept_parameter,
         .child_type = leafF, // ept_leaf:
         .children = {},
-        .to_string = [=](std::vector<std::string>) { return std::to_string(value); },
+        .format = value_format,
         .leaf_value = value
     });
 }
@@ -134,7 +339,7 @@ EncodedPhenotype Parameter(std::vector<EncodedPhenotype> parameters) {
         .type = paramF,
         .child_type = leafF,
         .children = {},
-        .to_string = [=](std::vector<std::string>) { return std::to_string(value); },
+        .format = value_format,
         .leaf_value = value
     });
 }
@@ -147,27 +352,29 @@ EncodedPhenotype Event(std::vector<EncodedPhenotype> parameters) {
         if (any_of(
                 parameters.begin(), 
                 parameters.end(), 
-                [](EncodedPhenotype p) { return !isEncodedPhenotypeTypeAParameterType(p.getType()); })
+                [](EncodedPhenotype& p) { return !isEncodedPhenotypeTypeAParameterType(p.getType()); })
         ) {
             error = true;
             error_message += " - Not all arguments are of parameter type.\n";
         }
 
-        if (parameters.size() != CURRENT_SPECIES.getParameterTypes().size()) {
-            error = true;
-            error_message += " - Missmatch on number of parameters.\n";
-        }
+        // Fields are checked against a layout by Species::Event
 
         if (error) {
             throw std::runtime_error(error_message);
         }
     #endif
 
+    return EventFrom(parameters);
+}
+
+EncodedPhenotype EventFrom(std::span<EncodedPhenotype> parameters) {
     return EncodedPhenotype({
         .type = eventF,
         .child_type = paramF,
-        .children = parameters,
-        .to_string = [](std::vector<std::string> children_strings) { return "e(" + join(children_strings) + ")"; },
+        .children = toChildren(parameters),
+        .label = "e",
+        .format = labelled_children_format,
         .leaf_value = -1.0
     });
 }
@@ -177,7 +384,7 @@ EncodedPhenotype Voice(std::vector<EncodedPhenotype> parameters) {
         std::string error_message = "Error in typecheck for Voice construction:\n";
         bool error = false;
 
-        if (any_of(parameters.begin(), parameters.end(), [](EncodedPhenotype p) { return p.getType() != eventF; })) {
+        if (any_of(parameters.begin(), parameters.end(), [](EncodedPhenotype& p) { return p.getType() != eventF; })) {
             error = true;
             error_message += " - Not all parameters are of type ept_parameter.\n";
         }
@@ -187,11 +394,16 @@ EncodedPhenotype Voice(std::vector<EncodedPhenotype> parameters) {
         }
     #endif
 
+    return VoiceFrom(parameters);
+}
+
+EncodedPhenotype VoiceFrom(std::span<EncodedPhenotype> parameters) {
     return EncodedPhenotype({
         .type = voiceF,
         .child_type = eventF,
-        .children = parameters,
-        .to_string = [](std::vector<std::string> children_strings) { return "v(" + join(children_strings, ", ") + ")"; },
+        .children = toChildren(parameters),
+        .label = "v",
+        .format = labelled_children_format,
         .leaf_value = -1.0
     });
 }
@@ -201,7 +413,7 @@ EncodedPhenotype Score(std::vector<EncodedPhenotype> parameters) {
         std::string error_message = "Error in typecheck for Voice construction:\n";
         bool error = false;
 
-        if (any_of(parameters.begin(), parameters.end(), [](EncodedPhenotype p) { return p.getType() != voiceF; })) {
+        if (any_of(parameters.begin(), parameters.end(), [](EncodedPhenotype& p) { return p.getType() != voiceF; })) {
             error = true;
             error_message += ErrorCodes::BAD_ENC_PHEN_CONSTRUCTION_BAD_CHILD_TYPE;
         }
@@ -211,11 +423,16 @@ EncodedPhenotype Score(std::vector<EncodedPhenotype> parameters) {
         }
     #endif
 
+    return ScoreFrom(parameters);
+}
+
+EncodedPhenotype ScoreFrom(std::span<EncodedPhenotype> parameters) {
     return EncodedPhenotype({
         .type = scoreF,
         .child_type = voiceF,
-        .children = parameters,
-        .to_string = [](std::vector<std::string> children_strings) { return "s(" + join(children_strings) + ")"; },
+        .children = toChildren(parameters),
+        .label = "s",
+        .format = labelled_children_format,
         .leaf_value = -1.0
     });
 }
\ No newline at end of file
@@ -1,13 +1,21 @@
 #ifndef __GENOMUS_CORE_ENCODED_PHENOTYPE__
 #define __GENOMUS_CORE_ENCODED_PHENOTYPE__ 
 
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
-#include "species.hpp"
 
+#include "expression_writer.hpp"
 
 #define ENCODED_PHENOTYPES_TYPE_CHECK
+#define PHENOTYPE_ARENA_INITIAL_SIZE (64 * 1024)
+#define PHENOTYPE_ARENA_MAX_BLOCK_SIZE (4 * 1024)
 
 enum EncodedPhenotypeType {
     scoreF,
@@ -60,38 +68,148 @@ static const std::vector<EncodedPhenotypeType> parameterTypes = {
 
 std::string encodedPhenotypeTypeToString(const EncodedPhenotypeType& ept);
 
+/*
+    PhenotypeArena is a monotonic memory resource for the phenotype objects built while evaluating
+    a decoded genotype. Everything allocated in it is released in bulk by reset(), the same way 
+    GTree::clean() clears the tree, so phenotypes allocated in the arena must not outlive the reset.
+
+    The high water mark of the previous cycle becomes the initial buffer of the next one, so
+    a warmed up arena serves evaluations without touching the heap. Blocks freed during a cycle
+    (intermediate phenotypes of an evaluation) are recycled by a pool placed on top of the buffer.
+    Blocks larger than PHENOTYPE_ARENA_MAX_BLOCK_SIZE, the child arrays of long voices and scores,
+    are taken from the heap instead, since the buffer could not reclaim them until the reset.
+*/
+class PhenotypeArena {
+    private:
+        class UpstreamCounter : public std::pmr::memory_resource {
+            public:
+                size_t allocated_bytes = 0;
+            private:
+                void* do_allocate(size_t bytes, size_t alignment) override;
+                void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+                bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+        };
+
+        class BlockRouter : public std::pmr::memory_resource {
+            public:
+                std::pmr::memory_resource* small_blocks;
+            private:
+                void* do_allocate(size_t bytes, size_t alignment) override;
+                void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+                bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+        };
+
+        // Kept behind a pointer so that swapping arenas does not move the resources phenotypes point to
+        struct Storage {
+            size_t buffer_size;
+            std::unique_ptr<std::byte[]> buffer;
+            UpstreamCounter upstream;
+            std::optional<std::pmr::monotonic_buffer_resource> resource;
+            std::optional<std::pmr::unsynchronized_pool_resource> pool;
+            BlockRouter router;
+        };
+
+        std::unique_ptr<Storage> _storage;
+
+        void _emplaceResources();
+        void _emplacePool();
+    public:
+        PhenotypeArena(size_t initial_size = PHENOTYPE_ARENA_INITIAL_SIZE);
+        PhenotypeArena(const PhenotypeArena&) = delete;
+        PhenotypeArena& operator=(const PhenotypeArena&) = delete;
+
+        std::pmr::memory_resource* resource();
+        void reset();
+        size_t capacity() const;
+        void swap(PhenotypeArena&) noexcept;
+
+        // Resource used for phenotypes built by the calling thread. Heap when no arena is in scope.
+        static std::pmr::memory_resource* current();
+
+        // Installs an arena as the current resource of the calling thread for its lifetime.
+        class Scope {
+            private:
+                std::pmr::memory_resource* _previous;
+            public:
+                Scope(PhenotypeArena&);
+                // Installs any resource, such as std::pmr::new_delete_resource()
+                Scope(std::pmr::memory_resource*);
+                ~Scope();
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+        };
+};
+
+// How an EncodedPhenotype is printed: "value", "label(value)" or "label(child, child, ...)"
+enum EncodedPhenotypeFormat {
+    value_format,
+    labelled_value_format,
+    labelled_children_format,
+};
+
 class EncodedPhenotype {
     public:
+        using Children = std::pmr::vector<EncodedPhenotype>;
+
         struct EncodedPhenotypeInitializer {
             EncodedPhenotypeType type;
             EncodedPhenotypeType child_type;
-            std::vector<EncodedPhenotype> children;
-            std::function<std::string(std::vector<std::string>)> to_string;
+            Children children;
+            // Labels must outlive the phenotype: use string literals, function names or internString
+            std::string_view label;
+            EncodedPhenotypeFormat format;
             double leaf_value;
         };
     
     private:
         EncodedPhenotypeType _type;
         EncodedPhenotypeType _child_type;
-        std::vector<EncodedPhenotype> _children;
-        std::function<std::string(std::vector<std::string>)> _to_string;
+        Children _children;
+        std::string_view _label;
+        EncodedPhenotypeFormat _format;
         double _leaf_value;
     public:
         EncodedPhenotype(EncodedPhenotypeInitializer);
-        EncodedPhenotypeType getType();
-        EncodedPhenotypeType getChildType();
-        std::string toString();
-        const std::vector<EncodedPhenotype>& getChildren();
-        double getLeafValue();
+        // Copies are placed on the heap so they can outlive the arena, moves keep their storage.
+        EncodedPhenotype(const EncodedPhenotype&);
+        EncodedPhenotype(EncodedPhenotype&&) noexcept = default;
+        EncodedPhenotype& operator=(const EncodedPhenotype&) = default;
+        EncodedPhenotype& operator=(EncodedPhenotype&&) = default;
+
+        EncodedPhenotypeType getType() const;
+        EncodedPhenotypeType getChildType() const;
+        // Appends the expression of the phenotype to output, so that buffers can be reused
+        void writeString(std::string& output, ExpressionStyle = compact_expression) const;
+        std::string toString(ExpressionStyle = compact_expression) const;
+        const Children& getChildren() const;
+        // Moves the children out, leaving this phenotype without children
+        Children takeChildren();
+        void appendChildren(Children&&);
+        double getLeafValue() const;
+        // Normalized vectors are written in two passes: the exact size first, then a flat fill
+        size_t normalizedVectorSize() const;
+        double* writeNormalizedVector(double* out) const;
+        // Appends to a caller provided buffer, which can be reused across phenotypes
+        void appendNormalizedVector(std::vector<double>& out) const;
         std::vector<double> toNormalizedVector() const;
 };
 
+// Moves phenotypes into child storage placed in the current phenotype resource
+EncodedPhenotype::Children toChildren(std::vector<EncodedPhenotype>&&);
+EncodedPhenotype::Children toChildren(std::span<EncodedPhenotype>);
+
 EncodedPhenotype Parameter(double value);
 EncodedPhenotype Parameter(std::vector<EncodedPhenotype> parameters);
 EncodedPhenotype Event(std::vector<EncodedPhenotype> parameters);
 EncodedPhenotype Voice(std::vector<EncodedPhenotype> parameters);
 EncodedPhenotype Score(std::vector<EncodedPhenotype> parameters);
 
+// Builders used when evaluating a GTree, whose types are validated when the tree is built.
+// Same as Event, Voice and Score without the type checks, and the parameters are moved into the result.
+EncodedPhenotype EventFrom(std::span<EncodedPhenotype> parameters);
+EncodedPhenotype VoiceFrom(std::span<EncodedPhenotype> parameters);
+EncodedPhenotype ScoreFrom(std::span<EncodedPhenotype> parameters);
+
 using enc_phen_t = EncodedPhenotype;
 
 #endif
\ No newline at end of file
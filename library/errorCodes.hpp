@@ -19,7 +19,36 @@ namespace ErrorCodes {
         ALREADY_EXISTING_FUNCTION_INDEX = "ALREADY_EXISTING_FUNCTION_INDEX",
         ALIASING_AN_ALIAS_IS_NOT_SUPPORTED = "ALIASING_AN_ALIAS_IS_NOT_SUPPORTED",
         PARAMETER_IS_NOT_A_LEAF = "PARAMETER_IS_NOT_A_LEAF",
-        PARAMETER_IS_NOT_A_LIST = "PARAMETER_IS_NOT_A_LIST";
+        PARAMETER_IS_NOT_A_LIST = "PARAMETER_IS_NOT_A_LIST",
+        INDEX_FILE_NOT_ACCESSIBLE = "INDEX_FILE_NOT_ACCESSIBLE",
+        BAD_INDEX_FILE = "BAD_INDEX_FILE",
+        STORE_FILE_NOT_ACCESSIBLE = "STORE_FILE_NOT_ACCESSIBLE",
+        BAD_STORE_FILE = "BAD_STORE_FILE",
+        SERVER_SOCKET_NOT_ACCESSIBLE = "SERVER_SOCKET_NOT_ACCESSIBLE",
+        BAD_SERVER_REQUEST = "BAD_SERVER_REQUEST",
+        EMPTY_GERMINAL_VECTOR = "EMPTY_GERMINAL_VECTOR",
+        BAD_NORMALIZED_VECTOR_OPENING_MARKER = "BAD_NORMALIZED_VECTOR_OPENING_MARKER",
+        BAD_NORMALIZED_VECTOR_FUNCTION_INDEX = "BAD_NORMALIZED_VECTOR_FUNCTION_INDEX",
+        BAD_NORMALIZED_VECTOR_LEAF_TYPE_MARKER = "BAD_NORMALIZED_VECTOR_LEAF_TYPE_MARKER",
+        BAD_NORMALIZED_VECTOR_CLOSING_MARKER = "BAD_NORMALIZED_VECTOR_CLOSING_MARKER",
+        BAD_NORMALIZED_VECTOR_TRUNCATED = "BAD_NORMALIZED_VECTOR_TRUNCATED",
+        BAD_NORMALIZED_VECTOR_TRAILING_VALUES = "BAD_NORMALIZED_VECTOR_TRAILING_VALUES";
+
+    // Errors returned by the non-throwing API, see GenomusError. Each one stands for the code of the same name.
+    enum ErrorCode {
+        bad_gfunction_parameters,
+        bad_autoreference,
+        bad_autoreference_index,
+        bad_parser_entry_bad_parenthesis,
+        bad_parser_entry_bad_function_name,
+        empty_germinal_vector,
+        bad_normalized_vector_opening_marker,
+        bad_normalized_vector_function_index,
+        bad_normalized_vector_leaf_type_marker,
+        bad_normalized_vector_closing_marker,
+        bad_normalized_vector_truncated,
+        bad_normalized_vector_trailing_values,
+    };
 }
 
 #endif
\ No newline at end of file
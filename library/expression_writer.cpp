@@ -0,0 +1,39 @@
+#include "expression_writer.hpp"
+
+#include <charconv>
+#include <iterator>
+
+ExpressionWriter::ExpressionWriter(std::string& output, ExpressionStyle style) : _output(output), _style(style) {}
+
+void ExpressionWriter::_separate() {
+    if (!this -> _arguments.empty() && this -> _arguments.back()++ > 0) this -> _output += ", ";
+}
+
+void ExpressionWriter::_newLine() {
+    this -> _output += '\n';
+    for (size_t k = 0; k < this -> _arguments.size(); ++k) this -> _output += EXPRESSION_INDENTATION;
+}
+
+void ExpressionWriter::open(std::string_view name) {
+    this -> _separate();
+    this -> _output += name;
+    this -> _output += '(';
+    this -> _arguments.push_back(0);
+
+    if (this -> _style == pretty_expression) this -> _newLine();
+}
+
+void ExpressionWriter::close() {
+    this -> _arguments.pop_back();
+
+    if (this -> _style == pretty_expression) this -> _newLine();
+    this -> _output += ')';
+}
+
+void ExpressionWriter::value(double x) {
+    char buffer[64];
+    this -> _separate();
+    // Same format as std::to_string
+    const auto [end, error] = std::to_chars(std::begin(buffer), std::end(buffer), x, std::chars_format::fixed, 6);
+    this -> _output.append(buffer, error == std::errc() ? end : buffer);
+}
@@ -0,0 +1,41 @@
+#ifndef __GENOMUS_CORE_EXPRESSION_WRITER__
+#define __GENOMUS_CORE_EXPRESSION_WRITER__
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#define EXPRESSION_INDENTATION "    "
+
+// How expressions are written: in a single line, or as prettyPrint lays them out
+enum ExpressionStyle {
+    compact_expression,
+    pretty_expression,
+};
+
+/*
+    ExpressionWriter appends expressions like "name(value, name(value))" to a string, one function or
+    value at a time. Arguments are separated as they are written, so nothing written is ever trimmed
+    or copied again, and expressions are written in a single pass whatever their size.
+
+    Values are written as std::to_string writes doubles. The pretty style opens a new line, one level
+    deeper, after every "(" and closes every ")" on a line of its own.
+*/
+class ExpressionWriter {
+    private:
+        std::string& _output;
+        ExpressionStyle _style;
+        // Arguments written to every open function
+        std::vector<size_t> _arguments;
+
+        void _separate();
+        void _newLine();
+    public:
+        ExpressionWriter(std::string& output, ExpressionStyle style = compact_expression);
+
+        void open(std::string_view name);
+        void close();
+        void value(double);
+};
+
+#endif
@@ -1,10 +1,14 @@
 #include "decoded_genotype.hpp"
 #include "encoded_phenotype.hpp"
 #include "errorCodes.hpp"
+#include "function_selection_table.hpp"
+#include "species.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
+#include <array>
 #include <ostream>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 
@@ -208,18 +212,21 @@ GTree::GFunction::GFunctionInitializer buildParameterFunction(std::string name,
         throw std::runtime_error(ErrorCodes::INVALID_CALL);
     }
     
+    const std::string_view label = internString(name);
+
     return {
         .name = name,
         .index = index,
         .param_types = { leafF },
         .output_type = output_type,
-        .compute = [=](std::vector<enc_phen_t> params) -> enc_phen_t {
+        .compute = [=](std::span<enc_phen_t> params) -> enc_phen_t {
             const double encoded_parameter_value = encodeParameter(output_type, params[0].getLeafValue());
             return EncodedPhenotype({
                 .type = output_type,
                 .child_type = leafF,
-                .children = params,
-                .to_string = [=](std::vector<std::string> children_strings) { return name + "(" + std::to_string(encoded_parameter_value) + ")"; },
+                .children = toChildren(params),
+                .label = label,
+                .format = labelled_value_format,
                 .leaf_value = encoded_parameter_value,
             });
         },
@@ -232,22 +239,25 @@ GTree::GFunction::GFunctionInitializer buildListFunction(std::string name, Encod
         throw std::runtime_error(ErrorCodes::INVALID_CALL);
     }
     
+    const std::string_view label = internString(name);
+
     return {
         .name = name,
         .index = index,
         .param_types = { listF },
         .output_type = output_type,
-        .compute = [=](std::vector<enc_phen_t> params) -> enc_phen_t {
+        .compute = [=](std::span<enc_phen_t> params) -> enc_phen_t {
             double encoded_parameter_value;
 
-            for (auto&& param: params) {
+            for (auto& param: params) {
                 encoded_parameter_value = encodeParameter(output_type, param.getLeafValue());
 
+                enc_phen_t leaf = std::move(param);
                 param = EncodedPhenotype({
                     .type = listToParameterType(output_type),
                     .child_type = leafF,
-                    .children = { param },
-                    .to_string = [=](std::vector<std::string> children_strings) { return std::to_string(encoded_parameter_value); },
+                    .children = toChildren({ &leaf, 1 }),
+                    .format = value_format,
                     .leaf_value = encoded_parameter_value,
                 });
             }
@@ -255,12 +265,9 @@ GTree::GFunction::GFunctionInitializer buildListFunction(std::string name, Encod
             return EncodedPhenotype({
                 .type = output_type,
                 .child_type = listToParameterType(output_type),
-                .children = params,
-                .to_string = [=](std::vector<std::string> children_strings) { 
-                    std::vector<std::string> evaluated_children;
-                    std::for_each(params.begin(), params.end(), [&](auto param) { evaluated_children.push_back(param.toString()); });
-                    return name + "(" + join(evaluated_children) + ")"; 
-                },
+                .children = toChildren(params),
+                .label = label,
+                .format = labelled_children_format,
                 .leaf_value = encoded_parameter_value,
             });
         },
@@ -269,24 +276,43 @@ GTree::GFunction::GFunctionInitializer buildListFunction(std::string name, Encod
 }
 
 
+// Event function of a species, with one parameter per field of its layout.
+// Nodes are type checked against the layout when built, so events are not checked again when evaluated.
+template<typename Layout>
+GTree::GFunction::GFunctionInitializer buildEventFunction(std::string name, size_t index) {
+    return {
+        .name = name,
+        .index = index,
+        .param_types = std::vector<EncodedPhenotypeType>(Layout::fields.begin(), Layout::fields.end()),
+        .output_type = eventF,
+        .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
+            return EventFrom(params);
+        },
+        .default_function_for_type = true,
+    };
+}
+
 GTree::GFunction::GFunctionInitializer buildRandomFunction(std::string name, EncodedPhenotypeType output_type, size_t index) {
+    const std::string_view label = internString(name);
+
     return {
         .name = name,
         .index = index,
         .param_types = {},
         .output_type = output_type,
-        .compute = [=](std::vector<enc_phen_t> params) -> enc_phen_t {
+        .compute = [=](std::span<enc_phen_t> params) -> enc_phen_t {
             if (params.size() == 0) {
                 const double random_number = GTree::RNG.nextDouble();
                 return enc_phen_t({
                     .type = output_type,
                     .child_type = leafF,
                     .children = {},
-                    .to_string = [=](std::vector<std::string> children_strings) { return name + "(" + std::to_string(random_number) + ")"; },
+                    .label = label,
+                    .format = labelled_value_format,
                     .leaf_value = random_number,
                 });
             } else {
-                return params[0];
+                return std::move(params[0]);
             }
         },
         .is_random = true,
@@ -304,30 +330,21 @@ p({
     .index = 100,
     .param_types = { leafF },
     .output_type = paramF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
         return Parameter(params[0].getLeafValue());
     },
     .default_function_for_type = true,
 }),
 
-e_piano({
-    .name = "e_piano",
-    .index = 2,
-    .param_types = { noteValueF, midiPitchF, articulationF, intensityF },
-    .output_type = eventF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
-        return Event(params);
-    },
-    .default_function_for_type = true,
-}),
+e_piano(buildEventFunction<PianoEventLayout>("e_piano", 2)),
 
 v({
     .name = "v",
     .index = 3,
     .param_types = { eventF },
     .output_type = voiceF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
-        return Voice(params);
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
+        return VoiceFrom(params);
     },
     .default_function_for_type = true,
 }),
@@ -337,8 +354,8 @@ s({
     .index = 4,
     .param_types = { voiceF },
     .output_type = scoreF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
-        return Score(params);
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
+        return ScoreFrom(params);
     },
     .default_function_for_type = true,
 }),
@@ -364,8 +381,8 @@ s2V({
     .index = 104,
     .param_types = { voiceF, voiceF },
     .output_type = scoreF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
-        return Score(params);
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
+        return ScoreFrom(params);
     },
 }),
 
@@ -374,8 +391,8 @@ vConcatE({
     .index = 42,
     .param_types = { eventF, eventF },
     .output_type = voiceF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
-        return Voice(params);
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
+        return VoiceFrom(params);
     },
 }),
 
@@ -384,12 +401,10 @@ vConcatV({
     .index = 43,
     .param_types = { voiceF, voiceF },
     .output_type = voiceF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
-        std::vector<enc_phen_t> events;
-        events.insert(events.end(), params[0].getChildren().begin(), params[0].getChildren().end());
-        events.insert(events.end(), params[1].getChildren().begin(), params[1].getChildren().end());
-        
-        return Voice(events);
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
+        // Both arguments are voices: the second voice's events are moved into the first
+        params[0].appendChildren(params[1].takeChildren());
+        return std::move(params[0]);
     },
 }),
 
@@ -398,7 +413,7 @@ vMotif({
     .index = 199,
     .param_types = { lnoteValueF, lmidiPitchF, larticulationF, lintensityF },
     .output_type = voiceF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
         std::vector<enc_phen_t> events;
         size_t min = -1;
 
@@ -406,16 +421,25 @@ vMotif({
             min = std::min(min, param.getChildren().size());
         }
 
+        // Each list item is used once, so it is moved into its event
+        std::array<EncodedPhenotype::Children, 4> lists = {
+            params[0].takeChildren(),
+            params[1].takeChildren(),
+            params[2].takeChildren(),
+            params[3].takeChildren(),
+        };
+
         for (size_t i = 0; i < min; ++i) {
-            events.push_back(Event({
-                params[0].getChildren()[i],
-                params[1].getChildren()[i],
-                params[2].getChildren()[i],
-                params[3].getChildren()[i],
-            }));
+            std::array<enc_phen_t, 4> event_parameters = {
+                std::move(lists[0][i]),
+                std::move(lists[1][i]),
+                std::move(lists[2][i]),
+                std::move(lists[3][i]),
+            };
+            events.push_back(EventFrom(event_parameters));
         }
 
-        return Voice(events);
+        return Voice(std::move(events));
     },
 }),
 
@@ -424,7 +448,7 @@ vMotifLoop({
     .index = 200,
     .param_types = { lnoteValueF, lmidiPitchF, larticulationF, lintensityF },
     .output_type = voiceF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
         std::vector<enc_phen_t> events;
         size_t max = 0;
 
@@ -441,7 +465,7 @@ vMotifLoop({
             }));
         }
 
-        return Voice(events);
+        return Voice(std::move(events));
     },
 }),
 
@@ -450,7 +474,7 @@ vPerpetuumMobile({
     .index = 201,
     .param_types = { noteValueF, lmidiPitchF, larticulationF, lintensityF },
     .output_type = voiceF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
         std::vector<enc_phen_t> events;
         size_t min = -1;
 
@@ -458,16 +482,23 @@ vPerpetuumMobile({
             min = std::min(min, param.getChildren().size());
         }
 
+        std::array<EncodedPhenotype::Children, 3> lists = {
+            params[1].takeChildren(),
+            params[2].takeChildren(),
+            params[3].takeChildren(),
+        };
+
         for (size_t i = 0; i < min; ++i) {
-            events.push_back(Event({
+            std::array<enc_phen_t, 4> event_parameters = {
                 params[0],
-                params[1].getChildren()[i],
-                params[2].getChildren()[i],
-                params[3].getChildren()[i],
-            }));
+                std::move(lists[0][i]),
+                std::move(lists[1][i]),
+                std::move(lists[2][i]),
+            };
+            events.push_back(EventFrom(event_parameters));
         }
 
-        return Voice(events);
+        return Voice(std::move(events));
     },
 }),
 
@@ -476,7 +507,7 @@ vPerpetuumMobileLoop({
     .index = 202,
     .param_types = { noteValueF, lmidiPitchF, larticulationF, lintensityF },
     .output_type = voiceF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
         std::vector<enc_phen_t> events;
         size_t max = 0;
 
@@ -493,7 +524,7 @@ vPerpetuumMobileLoop({
             }));
         }
 
-        return Voice(events);
+        return Voice(std::move(events));
     },
 }),
 
@@ -502,7 +533,7 @@ eAutoref({
     .index = 27,
     .param_types = { goldenintegerF },
     .output_type = eventF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
         // Autoreferences must be evaluated by the GTree object, not by the GFunction
         throw std::runtime_error(ErrorCodes::INVALID_CALL);
     },
@@ -514,7 +545,7 @@ vAutoref({
     .index = 28,
     .param_types = { goldenintegerF },
     .output_type = voiceF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
         throw std::runtime_error(ErrorCodes::INVALID_CALL);
     },
     .is_Autoreference = true,
@@ -525,12 +556,12 @@ sAddV({
     .index = 109,
     .param_types = { scoreF, voiceF },
     .output_type = scoreF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
-        auto& score = params[0], new_voice = params[1];
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
+        auto& score = params[0];
+        auto& new_voice = params[1];
 
-        std::vector<enc_phen_t> voices = score.getChildren();
-        voices.push_back(new_voice);
-        return Score(voices);
+        score.appendChildren(toChildren({ &new_voice, 1 }));
+        return std::move(score);
     },
 }),
 
@@ -539,8 +570,9 @@ sAddS({
     .index = 110,
     .param_types = { scoreF, scoreF },
     .output_type = scoreF,
-    .compute = [](std::vector<enc_phen_t> params) -> enc_phen_t {
-        return Score(params[0].getChildren() + params[1].getChildren());
+    .compute = [](std::span<enc_phen_t> params) -> enc_phen_t {
+        params[0].appendChildren(params[1].takeChildren());
+        return std::move(params[0]);
     },
 }), 
 
@@ -562,6 +594,8 @@ std::vector<std::string> exclude_functions = { };
 FunctionTypeDictionary function_type_dictionary;
 FunctionTypeDictionary default_function_type_dictionary;
 std::map<EncodedPhenotypeType, double> autoreference_type_dictionary;
+FunctionSelectionTable function_selection_table(function_type_dictionary);
+FunctionSelectionTable default_function_selection_table(default_function_type_dictionary);
 std::map<std::string, double> function_name_to_index;
 
 
@@ -628,6 +662,13 @@ void init_available_functions() {
         }
     }
 
+    // Keep dictionaries sorted, closest index lookups rely on it
+    for (auto& [type, v]: function_type_dictionary) std::sort(v.begin(), v.end());
+    for (auto& [type, v]: default_function_type_dictionary) std::sort(v.begin(), v.end());
+
+    function_selection_table = FunctionSelectionTable(function_type_dictionary);
+    default_function_selection_table = FunctionSelectionTable(default_function_type_dictionary);
+
     // Check correctness of default dictionary
     if (default_function_type_dictionary.size() != function_type_dictionary.size()) {
         throw std::runtime_error("Missing default functions for some types.");
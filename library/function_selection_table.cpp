@@ -0,0 +1,87 @@
+#include "function_selection_table.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Boundaries closer than this to a bucket may move into it with rounding, see the class comment
+static const double boundary_margin = 1e-9;
+
+double getClosestFunctionIndex(const FunctionTypeDictionary& dictionary, EncodedPhenotypeType type, double value, bool include_autoreferences) {
+    // Can return an autoreference function only if there are available subexpressions available.
+    // Dictionaries are sorted by init_available_functions
+    // Lookups do not insert, so that vectors can be normalized concurrently
+    const std::vector<double>& type_functions = dictionary.at(type);
+    double current_function_index = getClosestValueSorted(type_functions, value);
+
+    if (findWithDefault(autoreference_type_dictionary, type, 0.0) == current_function_index && !include_autoreferences) {
+        current_function_index = getClosestValueSorted(type_functions, value, true);
+    }
+
+    return current_function_index;
+}
+
+static size_t bucketPosition(EncodedPhenotypeType type, bool include_autoreferences, size_t bucket) {
+    return ((size_t) type * 2 + include_autoreferences) * FUNCTION_SELECTION_TABLE_BUCKETS + bucket;
+}
+
+FunctionSelectionTable::FunctionSelectionTable(const FunctionTypeDictionary& dictionary) : _dictionary(&dictionary) {
+    const size_t types = dictionary.empty() ? 0 : (size_t) dictionary.rbegin() -> first + 1;
+    const size_t buckets = FUNCTION_SELECTION_TABLE_BUCKETS;
+
+    this -> _functions.resize(types);
+    this -> _buckets.assign(types * 2 * buckets, FunctionSelectionTable::_unresolved);
+
+    for (auto& [type, functions]: dictionary) {
+        this -> _functions[type] = functions;
+
+        // Positions must fit a bucket, and excluding autoreferences needs an alternative
+        if (functions.size() >= FunctionSelectionTable::_unresolved) continue;
+
+        std::vector<double> boundaries;
+        for (size_t k = 0; k < functions.size(); ++k) {
+            boundaries.push_back(functions[k]);
+            if (k > 0) boundaries.push_back((functions[k - 1] + functions[k]) / 2);
+        }
+
+        std::vector<bool> crossed(buckets, false);
+        for (double boundary: boundaries) {
+            const double first = std::floor((boundary - boundary_margin) * buckets);
+            const double last = std::floor((boundary + boundary_margin) * buckets);
+            for (double bucket = std::max(first, 0.0); bucket <= std::min(last, buckets - 1.0); ++bucket) {
+                crossed[(size_t) bucket] = true;
+            }
+        }
+
+        for (bool include_autoreferences: { false, true }) {
+            if (!include_autoreferences && functions.size() < 2) continue;
+
+            for (size_t bucket = 0; bucket < buckets; ++bucket) {
+                if (crossed[bucket]) continue;
+
+                // No boundary within the bucket: its center selects the same function as any other value in it
+                const double center = (bucket + 0.5) / buckets;
+                const double selected = getClosestFunctionIndex(dictionary, type, center, include_autoreferences);
+                const size_t position = std::lower_bound(functions.begin(), functions.end(), selected) - functions.begin();
+
+                this -> _buckets[bucketPosition(type, include_autoreferences, bucket)] = (uint8_t) position;
+            }
+        }
+    }
+}
+
+double FunctionSelectionTable::select(EncodedPhenotypeType type, double value, bool include_autoreferences) const {
+    // Negated, so that NaN falls back too
+    if (!(value >= 0 && value < 1) || (size_t) type >= this -> _functions.size()) {
+        return getClosestFunctionIndex(*this -> _dictionary, type, value, include_autoreferences);
+    }
+
+    const size_t bucket = (size_t) (value * FUNCTION_SELECTION_TABLE_BUCKETS);
+    const uint8_t position = this -> _buckets[bucketPosition(type, include_autoreferences, bucket)];
+
+    if (position == FunctionSelectionTable::_unresolved) {
+        return getClosestFunctionIndex(*this -> _dictionary, type, value, include_autoreferences);
+    }
+
+    return this -> _functions[type][position];
+}
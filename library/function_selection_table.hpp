@@ -0,0 +1,45 @@
+#ifndef __GENOMUS_CORE_FUNCTION_SELECTION_TABLE__
+#define __GENOMUS_CORE_FUNCTION_SELECTION_TABLE__
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "decoded_genotype.hpp"
+
+#define FUNCTION_SELECTION_TABLE_BUCKETS 4096
+
+// Function index of type closest to value, searched over the sorted dictionary.
+// Autoreferences are only selected when include_autoreferences is set.
+double getClosestFunctionIndex(const FunctionTypeDictionary&, EncodedPhenotypeType type, double value, bool include_autoreferences);
+
+/*
+    FunctionSelectionTable resolves getClosestFunctionIndex in constant time. Gene values in [0, 1) are
+    quantized into buckets, and every bucket holds, per type and with or without autoreferences, the
+    function selected for any value in it.
+
+    Buckets a selection boundary (a function index or the midpoint of two consecutive ones) falls in,
+    or is too close to, are left unresolved and fall back to getClosestFunctionIndex, as do values out
+    of [0, 1). Selections are thus exactly the ones of getClosestFunctionIndex, ties included.
+
+    Tables are built by init_available_functions, from the sorted dictionaries, and only read afterwards.
+*/
+class FunctionSelectionTable {
+    private:
+        static constexpr uint8_t _unresolved = UINT8_MAX;
+
+        const FunctionTypeDictionary* _dictionary;
+        // Sorted function indices of every type, as in the dictionary
+        std::vector<std::vector<double>> _functions;
+        // Position in _functions of the selection of each bucket, per type and autoreference variant
+        std::vector<uint8_t> _buckets;
+    public:
+        FunctionSelectionTable(const FunctionTypeDictionary&);
+
+        double select(EncodedPhenotypeType type, double value, bool include_autoreferences) const;
+};
+
+extern FunctionSelectionTable function_selection_table;
+extern FunctionSelectionTable default_function_selection_table;
+
+#endif
@@ -7,7 +7,19 @@
 #include "decoded_genotype.hpp"
 #include "encoded_phenotype.hpp"
 
+#include "expression_writer.hpp"
+#include "function_selection_table.hpp"
 #include "parser.hpp"
+#include "profiler.hpp"
+#include "result.hpp"
+#include "species.hpp"
+#include "specimen.hpp"
+#include "population.hpp"
+#include "distance.hpp"
+#include "phenotype_index.hpp"
+#include "phenotype_cache.hpp"
+#include "phenotype_store.hpp"
+#include "task_pool.hpp"
 #include "utils.hpp"
 
 void init_genomus();
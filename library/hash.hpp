@@ -0,0 +1,27 @@
+#ifndef __GENOMUS_CORE_HASH__
+#define __GENOMUS_CORE_HASH__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+// 128 bit content hash, used as a key for content addressed storage of phenotypes
+struct Hash128 {
+    uint64_t low;
+    uint64_t high;
+
+    bool operator==(const Hash128&) const = default;
+};
+
+template<>
+struct std::hash<Hash128> {
+    size_t operator()(const Hash128& h) const noexcept { return h.low; }
+};
+
+// MurmurHash3 x64 128 of the given bytes
+Hash128 hash128(const void* data, size_t size, uint64_t seed = 0);
+// Hash of the values of a normalized vector, optionally mixed with a seed
+Hash128 hashNormalizedVector(std::span<const double>, uint64_t seed = 0);
+
+#endif
@@ -2,53 +2,82 @@
 #include "decoded_genotype.hpp"
 #include "encoded_genotype.hpp"
 #include "errorCodes.hpp"
+#include "result.hpp"
 #include "utils.hpp"
 #include <algorithm>
+#include <charconv>
 #include <iostream>
+#include <optional>
 #include <ostream>
 #include <regex>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
-size_t countOcurrences(std::string entry, char c) {
-    size_t result = 0;
-    for (char x : entry) if (x == c) result++;
+// Position of the first ")" closing nothing, or the end of the entry if a "(" is left open
+std::optional<size_t> unbalancedParenthesis(std::string_view entry) {
+    size_t open = 0;
 
-    return result;
-}
+    for (size_t k = 0; k < entry.size(); ++k) {
+        if (entry[k] == '(') open++;
+        if (entry[k] == ')' && open-- == 0) return k;
+    }
 
-bool wellFormedParenthesis(std::string entry) {
-    return countOcurrences(entry, '(') == countOcurrences(entry, ')');
+    if (open) return entry.size();
+    return std::nullopt;
 }
 
-std::vector<std::string> getTokens(std::string entry) {
+struct Token {
+    std::string text;
+    // Token as written in the entry, spaces included
+    std::string_view source;
+};
+
+std::vector<Token> getTokens(std::string_view entry) {
     std::string current_token = "";
-    std::vector<std::string> tokens;
+    size_t current_start = 0;
+    size_t current_end = 0;
+    std::vector<Token> tokens;
+
+    const auto pushCurrentToken = [&]() {
+        if (current_token.size()) tokens.push_back({ .text = current_token, .source = entry.substr(current_start, current_end - current_start) });
+        current_token = "";
+    };
+
+    for (size_t k = 0; k < entry.size(); ++k) {
+        const char c = entry[k];
 
-    for (char c: entry) {
         if (c == '(' || c == ')' || c == ',') {
-            if (current_token.size()) tokens.push_back(current_token);
-            tokens.push_back(std::string({c}));
-            current_token = "";
+            pushCurrentToken();
+            tokens.push_back({ .text = std::string({c}), .source = entry.substr(k, 1) });
         } else {
-            if (std::string("{}\n\t\r ").find(c) == std::string::npos) 
+            if (std::string_view("{}\n\t\r ").find(c) == std::string_view::npos) {
+                if (current_token.empty()) current_start = k;
                 current_token += c;
+                current_end = k + 1;
+            }
         }
     }
 
-    if (current_token.size()) tokens.push_back(current_token);
+    pushCurrentToken();
 
     return tokens;
 }
 
 struct TokenNode {
     std::string token;
+    std::string_view source;
     std::vector<size_t> children;
     size_t parent;
     bool root;
 };
 
+// Character of the entry a token starts at
+static size_t tokenPosition(std::string_view entry, std::string_view source) {
+    return source.data() - entry.data();
+}
+
 std::string print(const TokenNode& tn) {
     std::stringstream ss;
     ss << "Token: " << tn.token << '\n';
@@ -69,29 +98,32 @@ void printTokenTree(const std::vector<TokenNode>& tree) {
     std::cout << "]\n";
 }
 
-bool isTokenNumeric(std::string token) {
+bool isTokenNumeric(const std::string& token) {
     static const auto numeric_regex = std::regex("-?[0-9]+([\\.][0-9]+)?");
     return std::regex_match(token, numeric_regex);
 }
 
-std::vector<TokenNode> buildTokenTree(std::string entry) {
-    if (!wellFormedParenthesis(entry)) 
-        throw std::runtime_error(ErrorCodes::BAD_PARSER_ENTRY_BAD_PARENTHESIS);
+// Entry must have balanced parenthesis
+Result<std::vector<TokenNode>> buildTokenTree(std::string_view entry) {
     auto tokens = getTokens(entry);
 
     size_t current_parent = 0;
     std::vector<TokenNode> nodes;
 
-    for (auto token: tokens) {
-        if (token == "(") {
+    for (auto& token: tokens) {
+        if (token.text == "(") {
+            if (nodes.empty()) {
+                return GenomusError{ .code = ErrorCodes::bad_parser_entry_bad_parenthesis, .position = tokenPosition(entry, token.source), .function = {} };
+            }
             current_parent = nodes.size() - 1;
-        } else if (token == ")") {
+        } else if (token.text == ")") {
             current_parent = nodes[current_parent].parent;
-        } else if (token == ",") {
+        } else if (token.text == ",") {
 
         } else {
             nodes.push_back({
-                .token = token,
+                .token = std::move(token.text),
+                .source = token.source,
                 .children = {},
                 .parent = current_parent,
                 .root = false,
@@ -103,6 +135,10 @@ std::vector<TokenNode> buildTokenTree(std::string entry) {
         }
     }
 
+    if (nodes.empty()) {
+        return GenomusError{ .code = ErrorCodes::bad_parser_entry_bad_function_name, .position = entry.size(), .function = {} };
+    }
+
     // Resolve token aliases
     for (size_t i = 0; i < nodes.size(); ++i) {
         if (name_aliases.find(nodes[i].token) != name_aliases.end()) {
@@ -113,53 +149,110 @@ std::vector<TokenNode> buildTokenTree(std::string entry) {
     return nodes;
 }
 
-dec_gen_t tokenTreeToGTree(const std::vector<TokenNode>& token_nodes, size_t index = 0) {
-    auto token = token_nodes[index].token;
-
-    auto it = function_name_to_index.find(token);
-    if (it == function_name_to_index.end()) 
-        throw std::runtime_error(ErrorCodes::BAD_PARSER_ENTRY_BAD_FUNCTION_NAME + ": " + token);
+// Token being built into a node, while its children are built
+struct TokenTreeFrame {
+    size_t index;
+    GTree::GFunction* gfunction;
+    GTree::Children children;
+    size_t next_child;
+};
 
-    auto&& gfunction = available_functions[it -> second];
+// Nodes are built in post-order with an explicit stack of frames, so that deep expressions cannot overflow the call stack.
+// Children are built before their parent, as required by the node storage. Errors are positioned at the token causing them.
+Result<dec_gen_t> tokenTreeToGTree(std::string_view entry, const std::vector<TokenNode>& token_nodes, size_t index = 0) {
+    std::vector<TokenTreeFrame> frames;
+    std::optional<dec_gen_t> result;
+    std::optional<GenomusError> error;
+
+    // Builds leaves at once, or pushes the frame of the token
+    const auto enter = [&](size_t index) -> std::optional<dec_gen_t> {
+        const TokenNode& token_node = token_nodes[index];
+
+        auto it = function_name_to_index.find(token_node.token);
+        if (it == function_name_to_index.end()) {
+            error = GenomusError{ 
+                .code = ErrorCodes::bad_parser_entry_bad_function_name, 
+                .position = tokenPosition(entry, token_node.source), 
+                .function = token_node.source,
+            };
+            return std::nullopt;
+        }
 
-    if (token_nodes[index].children.size() == 1) {
-        auto first_child_token = token_nodes[token_nodes[index].children[0]].token; 
-        if (isTokenNumeric(first_child_token)) {
-            // Missing check for no siblings and no children
-            return gfunction(std::stof(first_child_token));
+        auto&& gfunction = available_functions.at(it -> second);
+
+        if (token_node.children.size() == 1) {
+            const TokenNode& first_child = token_nodes[token_node.children[0]]; 
+            if (isTokenNumeric(first_child.token)) {
+                // Missing check for no siblings and no children
+                float value;
+                const std::string& literal = first_child.token;
+                const auto [end, parse_error] = std::from_chars(literal.data(), literal.data() + literal.size(), value);
+
+                Result<GTree::GTreeIndex> leaf = parse_error == std::errc() 
+                    ? gfunction.tryApply(value) 
+                    : Result<GTree::GTreeIndex>(GenomusError{ .code = ErrorCodes::bad_gfunction_parameters, .position = 0, .function = gfunction.getNameView() });
+
+                if (!leaf) {
+                    error = leaf.error();
+                    error -> position = tokenPosition(entry, first_child.source);
+                    return std::nullopt;
+                }
+                return *leaf;
+            }
         }
-    }
-    //  else if (token_nodes[index].children.size() > 1) {
-    //     std::vector<std::string> children_tokens;
-    //     std::vector<dec_gen_t> leaf_children;
 
-    //     std::for_each(token_nodes[index].children.begin(), token_nodes[index].children.end(), [&](size_t child_index) {
-    //         children_tokens.push_back(token_nodes[child_index].token);
-    //     });
+        frames.push_back({ .index = index, .gfunction = &gfunction, .children = {}, .next_child = 0 });
+        return std::nullopt;
+    };
 
-    //     if (std::all_of(children_tokens.begin(), children_tokens.end(), [](std::string token){ return isTokenNumeric(token); })) {
+    result = enter(index);
 
-    //     }
-    // }
+    while (!error && !frames.empty()) {
+        TokenTreeFrame& frame = frames.back();
+        const std::vector<size_t>& token_children = token_nodes[frame.index].children;
 
-    std::vector<dec_gen_t> children({});
+        if (frame.next_child < token_children.size()) {
+            std::optional<dec_gen_t> child = enter(token_children[frame.next_child++]);
+            if (child) frames.back().children.push_back(*child);
+            continue;
+        }
 
-    std::for_each(token_nodes[index].children.begin(), token_nodes[index].children.end(), [&](size_t child_index) {
-        children.push_back(tokenTreeToGTree(token_nodes, child_index));
-    });
+        Result<dec_gen_t> node = frame.gfunction -> tryApply(frame.children);
+        if (!node) {
+            // Missing or extra children are reported at the function
+            const size_t mismatch = node.error().position;
+            error = node.error();
+            error -> position = tokenPosition(entry, token_nodes[mismatch < token_children.size() ? token_children[mismatch] : frame.index].source);
+            break;
+        }
+        frames.pop_back();
+
+        if (frames.empty()) {
+            result = *node;
+        } else {
+            frames.back().children.push_back(*node);
+        }
+    }
 
-    return gfunction(children);
+    if (error) return *error;
+    return *result;
 }
 
-dec_gen_t parseString(std::string entry) {
+Result<dec_gen_t> tryParseString(std::string_view entry) {
     if (entry == "") {
         return s({v({e_piano({n(0.1), m(0.1), a(0.1), i(0.1)})})});
     }
 
-    if (!wellFormedParenthesis(entry)) 
-        throw std::runtime_error(ErrorCodes::BAD_PARSER_ENTRY_BAD_PARENTHESIS);
+    if (const std::optional<size_t> position = unbalancedParenthesis(entry)) {
+        return GenomusError{ .code = ErrorCodes::bad_parser_entry_bad_parenthesis, .position = *position, .function = {} };
+    }
 
-    auto token_tree = buildTokenTree(entry);
+    Result<std::vector<TokenNode>> token_tree = buildTokenTree(entry);
+    if (!token_tree) return token_tree.error();
     
-    return tokenTreeToGTree(token_tree);
-}   
+    return tokenTreeToGTree(entry, *token_tree);
+}
+
+dec_gen_t parseString(std::string entry) {
+    return tryParseString(entry).valueOrThrow();
+}
@@ -1,8 +1,15 @@
 #ifndef __GENOMUS_CORE_PARSER__
 #define __GENOMUS_CORE_PARSER__
 
+#include <string>
+#include <string_view>
+
 #include "decoded_genotype.hpp"
+#include "result.hpp"
 
 dec_gen_t parseString(std::string);
+// Same as parseString, with errors positioned at the character of the entry they were found at.
+// Names of unknown functions in the error are views of the entry.
+Result<dec_gen_t> tryParseString(std::string_view);
 
-#endif
\ No newline at end of file
+#endif
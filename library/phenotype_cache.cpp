@@ -0,0 +1,182 @@
+#include "phenotype_cache.hpp"
+#include "errorCodes.hpp"
+
+#include <stdexcept>
+
+// Bookkeeping bytes charged per entry on top of its values: the entry itself and its hash map node
+static const size_t entry_overhead = sizeof(std::vector<double>) + sizeof(Hash128) * 2 + sizeof(size_t) * 4 + sizeof(void*) * 2;
+
+static size_t entryBytes(size_t values) {
+    return values * sizeof(double) + entry_overhead;
+}
+
+double PhenotypeCacheStats::hitRate() const {
+    return this -> hits + this -> misses ? (double) this -> hits / (this -> hits + this -> misses) : 0;
+}
+
+PhenotypeCache::PhenotypeCache(size_t memory_budget, size_t shards) : _hits(0), _misses(0), _stored_hits(0), _insertions(0), _evictions(0) {
+    this -> _store = nullptr;
+    if (!shards) {
+        throw std::runtime_error(ErrorCodes::INVALID_CALL);
+    }
+
+    this -> _shard_budget = memory_budget / shards;
+    for (size_t k = 0; k < shards; ++k) {
+        this -> _shards.push_back(std::make_unique<Shard>());
+    }
+}
+
+PhenotypeCache::Shard& PhenotypeCache::_shard(const Hash128& key) const {
+    return *this -> _shards[key.high % this -> _shards.size()];
+}
+
+const PhenotypeCache::Entry* PhenotypeCache::_find(Shard& shard, const Hash128& key) const {
+    auto it = shard.slots.find(key);
+    if (it == shard.slots.end()) return nullptr;
+
+    Entry& entry = shard.entries[it -> second];
+    entry.referenced = true;
+    return &entry;
+}
+
+bool PhenotypeCache::_get(const Hash128& key, bool& seed_dependent, std::vector<double>& out) {
+    {
+        Shard& shard = this -> _shard(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        if (const Entry* entry = this -> _find(shard, key)) {
+            seed_dependent = entry -> seed_dependent;
+            out.insert(out.end(), entry -> phenotype_vector.begin(), entry -> phenotype_vector.end());
+            return true;
+        }
+    }
+
+    const size_t previous_size = out.size();
+    if (!this -> _store || !this -> _store -> lookup(key, seed_dependent, out)) return false;
+
+    this -> _stored_hits++;
+    this -> _put(key, std::span<const double>(out).subspan(previous_size), seed_dependent);
+    return true;
+}
+
+bool PhenotypeCache::lookup(std::span<const double> normalized_vector, size_t seed, std::vector<double>& out) {
+    bool seed_dependent;
+
+    // Seed dependent genotypes only hold a marker, without values
+    if (!this -> _get(hashNormalizedVector(normalized_vector), seed_dependent, out)
+        || (seed_dependent && !this -> _get(hashNormalizedVector(normalized_vector, seed + 1), seed_dependent, out))) {
+        this -> _misses++;
+        return false;
+    }
+
+    this -> _hits++;
+    return true;
+}
+
+void PhenotypeCache::insert(std::span<const double> normalized_vector, size_t seed, bool seed_dependent, std::span<const double> phenotype_vector) {
+    const auto put = [&](const Hash128& key, std::span<const double> values, bool marker) {
+        this -> _put(key, values, marker);
+        if (this -> _store) this -> _store -> append(key, marker, values);
+    };
+
+    if (seed_dependent) {
+        put(hashNormalizedVector(normalized_vector), {}, true);
+        // Seeds are offset so that seed 0 does not collide with the genotype key
+        put(hashNormalizedVector(normalized_vector, seed + 1), phenotype_vector, false);
+    } else {
+        put(hashNormalizedVector(normalized_vector), phenotype_vector, false);
+    }
+}
+
+void PhenotypeCache::_put(const Hash128& key, std::span<const double> phenotype_vector, bool seed_dependent) {
+    const size_t bytes = entryBytes(phenotype_vector.size());
+    if (bytes > this -> _shard_budget) return;
+
+    Shard& shard = this -> _shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.slots.find(key);
+    if (it != shard.slots.end()) {
+        Entry& entry = shard.entries[it -> second];
+        shard.bytes -= entryBytes(entry.phenotype_vector.size());
+        shard.slots.erase(it);
+        entry.occupied = false;
+        shard.free_slots.push_back(&entry - shard.entries.data());
+    }
+
+    // CLOCK eviction: the hand clears reference bits and evicts the first entry found without one
+    while (shard.bytes + bytes > this -> _shard_budget) {
+        Entry& entry = shard.entries[shard.hand];
+        shard.hand = (shard.hand + 1) % shard.entries.size();
+
+        if (!entry.occupied) continue;
+        if (entry.referenced) {
+            entry.referenced = false;
+            continue;
+        }
+
+        shard.bytes -= entryBytes(entry.phenotype_vector.size());
+        shard.slots.erase(entry.key);
+        entry.occupied = false;
+        entry.phenotype_vector = {};
+        shard.free_slots.push_back(&entry - shard.entries.data());
+        this -> _evictions++;
+    }
+
+    size_t slot;
+    if (shard.free_slots.size()) {
+        slot = shard.free_slots.back();
+        shard.free_slots.pop_back();
+    } else {
+        slot = shard.entries.size();
+        shard.entries.emplace_back();
+    }
+
+    shard.entries[slot] = {
+        .key = key,
+        .phenotype_vector = std::vector<double>(phenotype_vector.begin(), phenotype_vector.end()),
+        .seed_dependent = seed_dependent,
+        .referenced = false,
+        .occupied = true,
+    };
+    shard.slots[key] = slot;
+    shard.bytes += bytes;
+    this -> _insertions++;
+}
+
+PhenotypeCacheStats PhenotypeCache::getStats() const {
+    PhenotypeCacheStats stats = {
+        .hits = this -> _hits,
+        .misses = this -> _misses,
+        .stored_hits = this -> _stored_hits,
+        .insertions = this -> _insertions,
+        .evictions = this -> _evictions,
+        .entries = 0,
+        .bytes = 0,
+    };
+
+    for (auto& shard : this -> _shards) {
+        std::lock_guard<std::mutex> lock(shard -> mutex);
+        stats.entries += shard -> slots.size();
+        stats.bytes += shard -> bytes;
+    }
+
+    return stats;
+}
+
+void PhenotypeCache::resetStats() {
+    this -> _hits = this -> _misses = this -> _stored_hits = this -> _insertions = this -> _evictions = 0;
+}
+
+void PhenotypeCache::setStore(PhenotypeStore* store) { this -> _store = store; }
+
+void PhenotypeCache::clear() {
+    for (auto& shard : this -> _shards) {
+        std::lock_guard<std::mutex> lock(shard -> mutex);
+        shard -> slots.clear();
+        shard -> entries.clear();
+        shard -> free_slots.clear();
+        shard -> hand = 0;
+        shard -> bytes = 0;
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef __GENOMUS_CORE_PHENOTYPE_CACHE__
+#define __GENOMUS_CORE_PHENOTYPE_CACHE__
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.hpp"
+#include "phenotype_store.hpp"
+
+#define PHENOTYPE_CACHE_DEFAULT_MEMORY_BUDGET (256 << 20)
+#define PHENOTYPE_CACHE_DEFAULT_SHARDS 16
+
+struct PhenotypeCacheStats {
+    size_t hits;
+    size_t misses;
+    // Hits found in the backing store, also counted in hits
+    size_t stored_hits;
+    size_t insertions;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+
+    double hitRate() const;
+};
+
+/*
+    PhenotypeCache maps normalized vectors (encoded genotypes) to the normalized vectors of their phenotypes,
+    so that genotypes seen before skip parsing and evaluation. Keys are 128 bit hashes of the normalized vector.
+
+    Genotypes whose evaluation draws from GTree::RNG have one phenotype per seed. Their genotype key only holds
+    a marker, and each phenotype is stored under a key that also hashes the seed.
+
+    The cache is split in shards, each one with its own lock and an equal part of the memory budget. When a shard
+    is full, entries are evicted with the CLOCK algorithm: entries read since the hand last passed get a second chance.
+
+    An optional PhenotypeStore backs the cache on disk: insertions are appended to it, and memory misses are
+    looked up in it, so phenotypes evaluated by previous runs are not evaluated again.
+*/
+class PhenotypeCache {
+    private:
+        struct Entry {
+            Hash128 key;
+            std::vector<double> phenotype_vector;
+            bool seed_dependent;
+            bool referenced;
+            bool occupied;
+        };
+
+        struct Shard {
+            std::mutex mutex;
+            std::unordered_map<Hash128, size_t> slots;
+            std::vector<Entry> entries;
+            std::vector<size_t> free_slots;
+            size_t hand = 0;
+            size_t bytes = 0;
+        };
+
+        size_t _shard_budget;
+        std::vector<std::unique_ptr<Shard>> _shards;
+        PhenotypeStore* _store;
+        std::atomic<size_t> _hits, _misses, _stored_hits, _insertions, _evictions;
+
+        Shard& _shard(const Hash128&) const;
+        // Expects the shard to be locked
+        const Entry* _find(Shard&, const Hash128&) const;
+        // Looks the key up in memory, then in the store. Appends the values to out
+        bool _get(const Hash128&, bool& seed_dependent, std::vector<double>& out);
+        // Stores in memory only
+        void _put(const Hash128&, std::span<const double> phenotype_vector, bool seed_dependent);
+    public:
+        PhenotypeCache(size_t memory_budget = PHENOTYPE_CACHE_DEFAULT_MEMORY_BUDGET, size_t shards = PHENOTYPE_CACHE_DEFAULT_SHARDS);
+
+        // On a hit, appends the cached phenotype vector to out
+        bool lookup(std::span<const double> normalized_vector, size_t seed, std::vector<double>& out);
+        // seed_dependent tells whether the evaluation drew from GTree::RNG
+        void insert(std::span<const double> normalized_vector, size_t seed, bool seed_dependent, std::span<const double> phenotype_vector);
+
+        PhenotypeCacheStats getStats() const;
+        void resetStats();
+        // Not owned by the cache. nullptr disables the backing store
+        void setStore(PhenotypeStore*);
+        // Clears the memory entries, not the backing store
+        void clear();
+};
+
+#endif
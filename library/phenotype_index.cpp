@@ -0,0 +1,234 @@
+#include "phenotype_index.hpp"
+#include "distance.hpp"
+#include "errorCodes.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+
+static const char INDEX_FILE_MAGIC[8] = { 'G', 'N', 'M', 'S', 'I', 'D', 'X', '1' };
+
+PhenotypeDescriptor toPhenotypeDescriptor(std::span<const double> phenotype_vector) {
+    PhenotypeDescriptor descriptor = {};
+    const size_t size = phenotype_vector.size();
+    if (!size) return descriptor;
+
+    for (size_t k = 0; k < PHENOTYPE_DESCRIPTOR_SIZE; ++k) {
+        const size_t begin = k * size / PHENOTYPE_DESCRIPTOR_SIZE;
+        // Vectors shorter than the descriptor repeat their values
+        const size_t end = std::max(begin + 1, (k + 1) * size / PHENOTYPE_DESCRIPTOR_SIZE);
+
+        double sum = 0;
+        for (size_t j = begin; j < end; ++j) sum += phenotype_vector[j];
+        descriptor[k] = sum / (end - begin);
+    }
+
+    return descriptor;
+}
+
+PhenotypeIndex::PhenotypeIndex(PhenotypeIndexInitializer init) {
+    if (!init.tables || !init.hashes_per_table || !(init.bucket_width > 0)) {
+        throw std::runtime_error(ErrorCodes::INVALID_CALL);
+    }
+
+    this -> _parameters = init;
+    this -> _tables.resize(init.tables);
+
+    std::mt19937_64 generator(init.seed);
+    std::normal_distribution<double> weight;
+    std::uniform_real_distribution<double> offset(0, init.bucket_width);
+
+    this -> _projections.resize(init.tables * init.hashes_per_table);
+    this -> _offsets.resize(init.tables * init.hashes_per_table);
+    for (size_t k = 0; k < this -> _projections.size(); ++k) {
+        for (auto& w : this -> _projections[k]) w = weight(generator);
+        this -> _offsets[k] = offset(generator);
+    }
+}
+
+std::vector<uint64_t> PhenotypeIndex::_keys(const PhenotypeDescriptor& descriptor) const {
+    std::vector<uint64_t> keys(this -> _parameters.tables);
+
+    for (size_t table = 0; table < keys.size(); ++table) {
+        uint64_t key = table;
+        for (size_t j = 0; j < this -> _parameters.hashes_per_table; ++j) {
+            const size_t projection = table * this -> _parameters.hashes_per_table + j;
+            double dot = this -> _offsets[projection];
+            for (size_t k = 0; k < PHENOTYPE_DESCRIPTOR_SIZE; ++k) dot += this -> _projections[projection][k] * descriptor[k];
+
+            const int64_t bucket = (int64_t) std::floor(dot / this -> _parameters.bucket_width);
+            key = (key ^ (uint64_t) bucket) * 0x9E3779B97F4A7C15ull;
+            key ^= key >> 32;
+        }
+        keys[table] = key;
+    }
+
+    return keys;
+}
+
+// Expects the lock to be held exclusively
+void PhenotypeIndex::_insert(const PhenotypeDescriptor& descriptor, size_t id, const std::vector<uint64_t>& keys) {
+    const uint32_t position = this -> _descriptors.size();
+    this -> _descriptors.push_back(descriptor);
+    this -> _ids.push_back(id);
+
+    for (size_t table = 0; table < keys.size(); ++table) {
+        this -> _tables[table][keys[table]].push_back(position);
+    }
+}
+
+void PhenotypeIndex::insert(std::span<const double> phenotype_vector, size_t id) {
+    this -> insert(toPhenotypeDescriptor(phenotype_vector), id);
+}
+
+void PhenotypeIndex::insert(const PhenotypeDescriptor& descriptor, size_t id) {
+    const auto keys = this -> _keys(descriptor);
+
+    std::unique_lock lock(this -> _mutex);
+    this -> _insert(descriptor, id, keys);
+}
+
+std::vector<PhenotypeIndex::Neighbour> PhenotypeIndex::query(std::span<const double> phenotype_vector, size_t k) const {
+    return this -> query(toPhenotypeDescriptor(phenotype_vector), k);
+}
+
+std::vector<PhenotypeIndex::Neighbour> PhenotypeIndex::query(const PhenotypeDescriptor& descriptor, size_t k) const {
+    const auto keys = this -> _keys(descriptor);
+    std::vector<uint32_t> candidates;
+    std::vector<Neighbour> neighbours;
+
+    std::shared_lock lock(this -> _mutex);
+
+    for (size_t table = 0; table < keys.size(); ++table) {
+        auto it = this -> _tables[table].find(keys[table]);
+        if (it != this -> _tables[table].end()) {
+            candidates.insert(candidates.end(), it -> second.begin(), it -> second.end());
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    neighbours.reserve(candidates.size());
+    for (uint32_t candidate : candidates) {
+        neighbours.push_back({ this -> _ids[candidate], l2Distance(descriptor, this -> _descriptors[candidate]) });
+    }
+
+    lock.unlock();
+
+    const auto closer = [](const Neighbour& a, const Neighbour& b) { return a.distance < b.distance; };
+    k = std::min(k, neighbours.size());
+    std::partial_sort(neighbours.begin(), neighbours.begin() + k, neighbours.end(), closer);
+    neighbours.resize(k);
+
+    return neighbours;
+}
+
+bool PhenotypeIndex::containsWithin(std::span<const double> phenotype_vector, double radius) const {
+    const auto nearest = this -> query(phenotype_vector, 1);
+    return nearest.size() && nearest[0].distance <= radius;
+}
+
+size_t PhenotypeIndex::size() const {
+    std::shared_lock lock(this -> _mutex);
+    return this -> _descriptors.size();
+}
+
+const PhenotypeIndexInitializer& PhenotypeIndex::getParameters() const { return this -> _parameters; }
+
+// Persistence. Files store the parameters, the projections and the indexed descriptors in native byte order.
+// Hash tables are rebuilt on load.
+
+template<typename T>
+static void write(std::ofstream& file, const T& value) {
+    file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<typename T>
+static void writeVector(std::ofstream& file, const std::vector<T>& values) {
+    file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template<typename T>
+static T read(std::ifstream& file) {
+    T value;
+    if (!file.read(reinterpret_cast<char*>(&value), sizeof(T))) {
+        throw std::runtime_error(ErrorCodes::BAD_INDEX_FILE);
+    }
+    return value;
+}
+
+template<typename T>
+static void readVector(std::ifstream& file, std::vector<T>& values, size_t size) {
+    values.resize(size);
+    if (!file.read(reinterpret_cast<char*>(values.data()), size * sizeof(T))) {
+        throw std::runtime_error(ErrorCodes::BAD_INDEX_FILE);
+    }
+}
+
+void PhenotypeIndex::save(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error(ErrorCodes::INDEX_FILE_NOT_ACCESSIBLE + ": " + path);
+    }
+
+    std::shared_lock lock(this -> _mutex);
+
+    file.write(INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC));
+    write<uint64_t>(file, PHENOTYPE_DESCRIPTOR_SIZE);
+    write<uint64_t>(file, this -> _parameters.tables);
+    write<uint64_t>(file, this -> _parameters.hashes_per_table);
+    write<double>(file, this -> _parameters.bucket_width);
+    write<uint64_t>(file, this -> _parameters.seed);
+    writeVector(file, this -> _projections);
+    writeVector(file, this -> _offsets);
+
+    write<uint64_t>(file, this -> _descriptors.size());
+    for (size_t id : this -> _ids) write<uint64_t>(file, id);
+    writeVector(file, this -> _descriptors);
+
+    if (!file) {
+        throw std::runtime_error(ErrorCodes::INDEX_FILE_NOT_ACCESSIBLE + ": " + path);
+    }
+}
+
+std::unique_ptr<PhenotypeIndex> PhenotypeIndex::load(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error(ErrorCodes::INDEX_FILE_NOT_ACCESSIBLE + ": " + path);
+    }
+
+    char magic[sizeof(INDEX_FILE_MAGIC)];
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, INDEX_FILE_MAGIC, sizeof(magic)) || read<uint64_t>(file) != PHENOTYPE_DESCRIPTOR_SIZE) {
+        throw std::runtime_error(ErrorCodes::BAD_INDEX_FILE + ": " + path);
+    }
+
+    PhenotypeIndexInitializer parameters;
+    parameters.tables = read<uint64_t>(file);
+    parameters.hashes_per_table = read<uint64_t>(file);
+    parameters.bucket_width = read<double>(file);
+    parameters.seed = read<uint64_t>(file);
+
+    auto index = std::make_unique<PhenotypeIndex>(parameters);
+    // Projections are read back rather than regenerated: random distributions are not portable across standard libraries
+    readVector(file, index -> _projections, parameters.tables * parameters.hashes_per_table);
+    readVector(file, index -> _offsets, parameters.tables * parameters.hashes_per_table);
+
+    const size_t size = read<uint64_t>(file);
+    std::vector<uint64_t> ids;
+    std::vector<PhenotypeDescriptor> descriptors;
+    readVector(file, ids, size);
+    readVector(file, descriptors, size);
+
+    index -> _descriptors.reserve(size);
+    index -> _ids.reserve(size);
+    for (size_t k = 0; k < size; ++k) {
+        index -> _insert(descriptors[k], ids[k], index -> _keys(descriptors[k]));
+    }
+
+    return index;
+}
@@ -0,0 +1,76 @@
+#ifndef __GENOMUS_CORE_PHENOTYPE_INDEX__
+#define __GENOMUS_CORE_PHENOTYPE_INDEX__
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define PHENOTYPE_DESCRIPTOR_SIZE 32
+
+// Fixed size summary of a phenotype normalized vector: the means of PHENOTYPE_DESCRIPTOR_SIZE equal segments
+using PhenotypeDescriptor = std::array<double, PHENOTYPE_DESCRIPTOR_SIZE>;
+
+PhenotypeDescriptor toPhenotypeDescriptor(std::span<const double> phenotype_vector);
+
+struct PhenotypeIndexInitializer {
+    size_t tables = 24;
+    size_t hashes_per_table = 4;
+    double bucket_width = 0.25;
+    size_t seed = 0;
+};
+
+/*
+    PhenotypeIndex answers approximate nearest neighbour queries over phenotype descriptors, using
+    locality sensitive hashing for L2 distance. Each of the hash tables hashes a descriptor by quantizing
+    hashes_per_table random projections with buckets of bucket_width. A query only computes exact
+    distances to the descriptors sharing a bucket with it in some table, instead of scanning the index.
+    More tables raise recall, more hashes per table make buckets smaller and queries faster.
+
+    Insertions and queries can run concurrently from any number of threads: hashing is done outside
+    the lock, queries share it and insertions hold it exclusively only to update the tables.
+*/
+class PhenotypeIndex {
+    public:
+        struct Neighbour {
+            size_t id;
+            double distance;
+        };
+
+    private:
+        PhenotypeIndexInitializer _parameters;
+        // tables * hashes_per_table projections, each one of PHENOTYPE_DESCRIPTOR_SIZE weights and an offset
+        std::vector<PhenotypeDescriptor> _projections;
+        std::vector<double> _offsets;
+
+        mutable std::shared_mutex _mutex;
+        std::vector<PhenotypeDescriptor> _descriptors;
+        std::vector<size_t> _ids;
+        std::vector<std::unordered_map<uint64_t, std::vector<uint32_t>>> _tables;
+
+        std::vector<uint64_t> _keys(const PhenotypeDescriptor&) const;
+        void _insert(const PhenotypeDescriptor&, size_t id, const std::vector<uint64_t>& keys);
+    public:
+        PhenotypeIndex(PhenotypeIndexInitializer = {});
+
+        void insert(std::span<const double> phenotype_vector, size_t id);
+        void insert(const PhenotypeDescriptor&, size_t id);
+
+        // Up to k approximate nearest neighbours, closest first
+        std::vector<Neighbour> query(std::span<const double> phenotype_vector, size_t k) const;
+        std::vector<Neighbour> query(const PhenotypeDescriptor&, size_t k) const;
+        // Whether some indexed descriptor is found within radius, for duplicate rejection
+        bool containsWithin(std::span<const double> phenotype_vector, double radius) const;
+
+        size_t size() const;
+        const PhenotypeIndexInitializer& getParameters() const;
+
+        void save(const std::string& path) const;
+        static std::unique_ptr<PhenotypeIndex> load(const std::string& path);
+};
+
+#endif
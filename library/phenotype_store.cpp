@@ -0,0 +1,262 @@
+#include "phenotype_store.hpp"
+#include "errorCodes.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char STORE_FILE_MAGIC[8] = { 'G', 'N', 'M', 'S', 'P', 'S', 'T', '1' };
+static const size_t STORE_HEADER_SIZE = 64;
+static const uint32_t RECORD_MAGIC = 0x52505347;  // "GSPR"
+static const uint32_t SEED_DEPENDENT_RECORD = 1;
+static const size_t MIN_MAP_CAPACITY = 1 << 20;
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t flags;
+    uint64_t count;
+    Hash128 key;
+    uint64_t checksum;
+};
+
+static uint64_t recordChecksum(const RecordHeader& header, const void* values) {
+    return hash128(values, header.count * sizeof(double), header.key.low ^ header.key.high ^ header.flags ^ header.count).low;
+}
+
+// Holds a flock for its lifetime
+class FileLock {
+    private:
+        int _fd;
+    public:
+        FileLock(int fd, int operation) : _fd(fd) { flock(fd, operation); }
+        ~FileLock() { flock(this -> _fd, LOCK_UN); }
+};
+
+static void writeAll(int fd, const void* data, size_t size, off_t offset, const std::string& path) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size) {
+        const ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0) {
+            throw std::runtime_error(ErrorCodes::STORE_FILE_NOT_ACCESSIBLE + ": " + path);
+        }
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+}
+
+PhenotypeStore::PhenotypeStore(const std::string& path, bool durable) : _path(path), _durable(durable) {
+    this -> _fd = -1;
+    this -> _map = nullptr;
+    this -> _map_capacity = 0;
+    this -> _open();
+    this -> refresh();
+
+    if (std::memcmp(this -> _map, STORE_FILE_MAGIC, sizeof(STORE_FILE_MAGIC))) {
+        this -> _close();
+        throw std::runtime_error(ErrorCodes::BAD_STORE_FILE + ": " + this -> _path);
+    }
+}
+
+PhenotypeStore::~PhenotypeStore() {
+    this -> _close();
+}
+
+void PhenotypeStore::_open() {
+    this -> _close();
+    this -> _fd = open(this -> _path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (this -> _fd < 0) {
+        throw std::runtime_error(ErrorCodes::STORE_FILE_NOT_ACCESSIBLE + ": " + this -> _path);
+    }
+
+    struct stat file_stat;
+    fstat(this -> _fd, &file_stat);
+    this -> _inode = file_stat.st_ino;
+    this -> _valid_size = STORE_HEADER_SIZE;
+    this -> _index.clear();
+
+    FileLock lock(this -> _fd, LOCK_EX);
+    if (this -> _fileSize() == 0) {
+        char header[STORE_HEADER_SIZE] = {};
+        std::memcpy(header, STORE_FILE_MAGIC, sizeof(STORE_FILE_MAGIC));
+        writeAll(this -> _fd, header, sizeof(header), 0, this -> _path);
+    }
+}
+
+void PhenotypeStore::_close() {
+    if (this -> _map) munmap(const_cast<char*>(this -> _map), this -> _map_capacity);
+    if (this -> _fd >= 0) close(this -> _fd);
+    this -> _map = nullptr;
+    this -> _map_capacity = 0;
+    this -> _fd = -1;
+}
+
+// Whether compact(), maybe from another process, renamed a new file over the open one
+bool PhenotypeStore::_replaced() const {
+    struct stat path_stat;
+    return stat(this -> _path.c_str(), &path_stat) || path_stat.st_ino != this -> _inode;
+}
+
+size_t PhenotypeStore::_fileSize() const {
+    struct stat file_stat;
+    fstat(this -> _fd, &file_stat);
+    return file_stat.st_size;
+}
+
+// The mapping may extend past the end of the file, only bytes below the file size are ever read
+void PhenotypeStore::_mapAtLeast(size_t size) {
+    if (size <= this -> _map_capacity) return;
+
+    size_t capacity = std::max(this -> _map_capacity, MIN_MAP_CAPACITY);
+    while (capacity < size) capacity *= 2;
+
+    if (this -> _map) munmap(const_cast<char*>(this -> _map), this -> _map_capacity);
+    void* map = mmap(nullptr, capacity, PROT_READ, MAP_SHARED, this -> _fd, 0);
+    if (map == MAP_FAILED) {
+        this -> _map = nullptr;
+        this -> _map_capacity = 0;
+        throw std::runtime_error(ErrorCodes::STORE_FILE_NOT_ACCESSIBLE + ": " + this -> _path);
+    }
+
+    this -> _map = static_cast<const char*>(map);
+    this -> _map_capacity = capacity;
+}
+
+// Indexes the valid records between _valid_size and file_size. Expects a flock to be held
+void PhenotypeStore::_scan(size_t file_size) {
+    if (file_size < STORE_HEADER_SIZE) {
+        throw std::runtime_error(ErrorCodes::BAD_STORE_FILE + ": " + this -> _path);
+    }
+
+    this -> _mapAtLeast(file_size);
+
+    while (this -> _valid_size + sizeof(RecordHeader) <= file_size) {
+        RecordHeader header;
+        std::memcpy(&header, this -> _map + this -> _valid_size, sizeof(header));
+        const char* values = this -> _map + this -> _valid_size + sizeof(header);
+
+        if (header.magic != RECORD_MAGIC || header.count > (file_size - this -> _valid_size - sizeof(header)) / sizeof(double)
+            || recordChecksum(header, values) != header.checksum) {
+            break;
+        }
+
+        this -> _index.emplace(header.key, this -> _valid_size);
+        this -> _valid_size += sizeof(header) + header.count * sizeof(double);
+    }
+}
+
+void PhenotypeStore::refresh() {
+    std::lock_guard<std::mutex> guard(this -> _mutex);
+
+    if (this -> _replaced()) this -> _open();
+
+    FileLock lock(this -> _fd, LOCK_SH);
+    this -> _scan(this -> _fileSize());
+}
+
+bool PhenotypeStore::lookup(const Hash128& key, bool& seed_dependent, std::vector<double>& out) {
+    std::lock_guard<std::mutex> guard(this -> _mutex);
+
+    auto it = this -> _index.find(key);
+    if (it == this -> _index.end()) return false;
+
+    RecordHeader header;
+    std::memcpy(&header, this -> _map + it -> second, sizeof(header));
+    const size_t previous_size = out.size();
+    out.resize(previous_size + header.count);
+    if (header.count) {
+        std::memcpy(out.data() + previous_size, this -> _map + it -> second + sizeof(header), header.count * sizeof(double));
+    }
+    seed_dependent = header.flags & SEED_DEPENDENT_RECORD;
+
+    return true;
+}
+
+bool PhenotypeStore::append(const Hash128& key, bool seed_dependent, std::span<const double> values) {
+    while (true) {
+        std::lock_guard<std::mutex> guard(this -> _mutex);
+        if (this -> _replaced()) this -> _open();
+
+        FileLock lock(this -> _fd, LOCK_EX);
+        // A compaction replaced the file while waiting for the lock
+        if (this -> _replaced()) continue;
+
+        this -> _scan(this -> _fileSize());
+        if (this -> _index.count(key)) return false;
+
+        // Whatever follows the last valid record was torn by a crash during an append
+        if (this -> _fileSize() > this -> _valid_size && ftruncate(this -> _fd, this -> _valid_size)) {
+            throw std::runtime_error(ErrorCodes::STORE_FILE_NOT_ACCESSIBLE + ": " + this -> _path);
+        }
+
+        RecordHeader header = {
+            .magic = RECORD_MAGIC,
+            .flags = seed_dependent ? SEED_DEPENDENT_RECORD : 0,
+            .count = values.size(),
+            .key = key,
+            .checksum = 0,
+        };
+        header.checksum = recordChecksum(header, values.data());
+
+        // The header goes last: until it is written the record fails validation
+        writeAll(this -> _fd, values.data(), values.size_bytes(), this -> _valid_size + sizeof(header), this -> _path);
+        writeAll(this -> _fd, &header, sizeof(header), this -> _valid_size, this -> _path);
+        if (this -> _durable) fdatasync(this -> _fd);
+
+        this -> _scan(this -> _valid_size + sizeof(header) + values.size_bytes());
+        return true;
+    }
+}
+
+void PhenotypeStore::compact(std::function<bool(const Hash128&)> keep) {
+    {
+        std::lock_guard<std::mutex> guard(this -> _mutex);
+        if (this -> _replaced()) this -> _open();
+
+        FileLock lock(this -> _fd, LOCK_EX);
+        this -> _scan(this -> _fileSize());
+
+        std::vector<size_t> offsets;
+        for (auto& [key, offset] : this -> _index) {
+            if (!keep || keep(key)) offsets.push_back(offset);
+        }
+        std::sort(offsets.begin(), offsets.end());
+
+        const std::string compact_path = this -> _path + ".compact";
+        const int fd = open(compact_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error(ErrorCodes::STORE_FILE_NOT_ACCESSIBLE + ": " + compact_path);
+        }
+
+        size_t size = STORE_HEADER_SIZE;
+        writeAll(fd, this -> _map, STORE_HEADER_SIZE, 0, compact_path);
+        for (size_t offset : offsets) {
+            RecordHeader header;
+            std::memcpy(&header, this -> _map + offset, sizeof(header));
+            const size_t record_size = sizeof(header) + header.count * sizeof(double);
+            writeAll(fd, this -> _map + offset, record_size, size, compact_path);
+            size += record_size;
+        }
+
+        // The new file must be complete on disk before it replaces the old one
+        fsync(fd);
+        close(fd);
+        if (rename(compact_path.c_str(), this -> _path.c_str())) {
+            throw std::runtime_error(ErrorCodes::STORE_FILE_NOT_ACCESSIBLE + ": " + this -> _path);
+        }
+    }
+
+    this -> refresh();
+}
+
+size_t PhenotypeStore::size() {
+    std::lock_guard<std::mutex> guard(this -> _mutex);
+    return this -> _index.size();
+}
+
+const std::string& PhenotypeStore::getPath() const { return this -> _path; }
@@ -0,0 +1,65 @@
+#ifndef __GENOMUS_CORE_PHENOTYPE_STORE__
+#define __GENOMUS_CORE_PHENOTYPE_STORE__
+
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.hpp"
+
+/*
+    PhenotypeStore is an append only file mapping normalized genotype hashes to phenotype normalized vectors,
+    so that phenotypes survive across runs. Used as the backing store of a PhenotypeCache.
+
+    The file is memory mapped for reading and indexed on open. Records carry a checksum: a record torn by a
+    crash fails it, is never read, and is truncated by the next append. Several processes can share a file:
+    appends and truncations hold an exclusive flock, scans a shared one, and refresh() picks up the records
+    appended by others. compact() rewrites the live records to a new file and renames it over the old one,
+    processes still reading the old file switch to the new one on their next refresh() or append().
+
+    POSIX only (mmap, flock).
+*/
+class PhenotypeStore {
+    private:
+        std::string _path;
+        bool _durable;
+        int _fd;
+        ino_t _inode;
+        const char* _map;
+        size_t _map_capacity;
+        // End of the last valid record
+        size_t _valid_size;
+        std::unordered_map<Hash128, size_t> _index;
+        std::mutex _mutex;
+
+        void _open();
+        void _close();
+        bool _replaced() const;
+        void _mapAtLeast(size_t);
+        void _scan(size_t file_size);
+        size_t _fileSize() const;
+    public:
+        // Durable stores fdatasync every append
+        PhenotypeStore(const std::string& path, bool durable = false);
+        ~PhenotypeStore();
+        PhenotypeStore(const PhenotypeStore&) = delete;
+        PhenotypeStore& operator=(const PhenotypeStore&) = delete;
+
+        // On success appends the stored values to out
+        bool lookup(const Hash128&, bool& seed_dependent, std::vector<double>& out);
+        // Returns false if the key is already stored, by this or another process
+        bool append(const Hash128&, bool seed_dependent, std::span<const double> values);
+        // Indexes the records appended by other processes
+        void refresh();
+        // Drops duplicated, torn and, if keep is given, rejected records
+        void compact(std::function<bool(const Hash128&)> keep = nullptr);
+
+        size_t size();
+        const std::string& getPath() const;
+};
+
+#endif
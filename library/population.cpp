@@ -0,0 +1,168 @@
+#include "population.hpp"
+#include "encoded_genotype.hpp"
+#include "errorCodes.hpp"
+#include "parser.hpp"
+
+#include <stdexcept>
+
+// Per chunk output of a bulk stage, before it is merged into the population arenas
+struct StageChunk {
+    std::vector<double> values;
+    std::vector<size_t> sizes;
+};
+
+static void mergeChunks(std::vector<StageChunk>& chunks, std::vector<double>& values, std::vector<size_t>& offsets) {
+    size_t total_values = 0, total_sizes = 0;
+    for (auto& chunk : chunks) {
+        total_values += chunk.values.size();
+        total_sizes += chunk.sizes.size();
+    }
+
+    values.clear();
+    values.reserve(total_values);
+    offsets.assign(1, 0);
+    offsets.reserve(total_sizes + 1);
+
+    for (auto& chunk : chunks) {
+        values.insert(values.end(), chunk.values.begin(), chunk.values.end());
+        for (size_t size : chunk.sizes) {
+            offsets.push_back(offsets.back() + size);
+        }
+    }
+}
+
+Population::Population(size_t threads) {
+    this -> _germinal_offsets = { 0 };
+    this -> _phenotype_cache = nullptr;
+    this -> setThreads(threads);
+}
+
+size_t Population::add(std::span<const double> germinal_vector, size_t seed) {
+    this -> _germinal_values.insert(this -> _germinal_values.end(), germinal_vector.begin(), germinal_vector.end());
+    this -> _germinal_offsets.push_back(this -> _germinal_values.size());
+    this -> _seeds.push_back(seed);
+
+    // Stages no longer cover the whole population
+    this -> _normalized_values.clear();
+    this -> _normalized_offsets.clear();
+    this -> _phenotype_values.clear();
+    this -> _phenotype_offsets.clear();
+
+    return this -> size() - 1;
+}
+
+void Population::reserve(size_t specimens, size_t values_per_specimen) {
+    this -> _germinal_values.reserve(specimens * values_per_specimen);
+    this -> _germinal_offsets.reserve(specimens + 1);
+    this -> _seeds.reserve(specimens);
+}
+
+void Population::clear() {
+    PhenotypeCache* phenotype_cache = this -> _phenotype_cache;
+    *this = Population(this -> _threads);
+    this -> _phenotype_cache = phenotype_cache;
+}
+
+size_t Population::size() const { return this -> _seeds.size(); }
+
+static std::span<const double> slice(const std::vector<double>& values, const std::vector<size_t>& offsets, size_t index) {
+    if (index + 1 >= offsets.size()) {
+        throw std::runtime_error(ErrorCodes::INVALID_CALL);
+    }
+
+    return std::span<const double>(values).subspan(offsets[index], offsets[index + 1] - offsets[index]);
+}
+
+std::span<const double> Population::getGerminalVector(size_t index) const {
+    return slice(this -> _germinal_values, this -> _germinal_offsets, index);
+}
+
+std::span<const double> Population::getNormalizedVector(size_t index) const {
+    return slice(this -> _normalized_values, this -> _normalized_offsets, index);
+}
+
+std::span<const double> Population::getPhenotypeVector(size_t index) const {
+    return slice(this -> _phenotype_values, this -> _phenotype_offsets, index);
+}
+
+size_t Population::getSeed(size_t index) const { return this -> _seeds.at(index); }
+
+Specimen Population::getSpecimen(size_t index) const {
+    const auto germinal_vector = this -> getGerminalVector(index);
+    return Specimen(enc_gen_t(germinal_vector.begin(), germinal_vector.end()), this -> getSeed(index));
+}
+
+bool Population::isNormalized() const { return this -> _normalized_offsets.size() == this -> size() + 1; }
+bool Population::isEvaluated() const { return this -> _phenotype_offsets.size() == this -> size() + 1; }
+
+void Population::normalizeAll() {
+    std::vector<StageChunk> chunks(std::min(this -> _threads, std::max<size_t>(1, this -> size())));
+
+    parallelChunks(this -> size(), chunks.size(), [&](size_t chunk, size_t begin, size_t end) {
+        StageChunk& output = chunks[chunk];
+        output.sizes.reserve(end - begin);
+
+        for (size_t k = begin; k < end; ++k) {
+            const auto germinal_vector = this -> getGerminalVector(k);
+            const size_t previous_size = output.values.size();
+
+            normalizeVector(enc_gen_t(germinal_vector.begin(), germinal_vector.end()), output.values);
+            output.sizes.push_back(output.values.size() - previous_size);
+        }
+    });
+
+    mergeChunks(chunks, this -> _normalized_values, this -> _normalized_offsets);
+}
+
+void Population::evaluateAll() {
+    if (!this -> isNormalized()) {
+        this -> normalizeAll();
+    }
+
+    std::vector<StageChunk> chunks(std::min(this -> _threads, std::max<size_t>(1, this -> size())));
+
+    parallelChunks(this -> size(), chunks.size(), [&](size_t chunk, size_t begin, size_t end) {
+        StageChunk& output = chunks[chunk];
+        output.sizes.reserve(end - begin);
+
+        // Trees are built in a context of their own, so the calling thread static data is left untouched
+        GTree::Context context;
+        GTree::Context::Scope scope(context);
+
+        for (size_t k = begin; k < end; ++k) {
+            const auto normalized_vector = this -> getNormalizedVector(k);
+
+            GTree::clean();
+            GTree::RNG.seed(this -> _seeds[k]);
+
+            const size_t previous_size = output.values.size();
+
+            if (!this -> _phenotype_cache || !this -> _phenotype_cache -> lookup(normalized_vector, this -> _seeds[k], output.values)) {
+                const size_t previous_draws = GTree::RNG.getDraws();
+
+                dec_gen_t tree = parseString(toExpression(enc_gen_t(normalized_vector.begin(), normalized_vector.end())));
+                tree.evaluate(GTree::phenotype_arena).appendNormalizedVector(output.values);
+
+                if (this -> _phenotype_cache) {
+                    const bool seed_dependent = GTree::RNG.getDraws() != previous_draws;
+                    const auto phenotype_vector = std::span<const double>(output.values).subspan(previous_size);
+                    this -> _phenotype_cache -> insert(normalized_vector, this -> _seeds[k], seed_dependent, phenotype_vector);
+                }
+            }
+
+            output.sizes.push_back(output.values.size() - previous_size);
+        }
+
+        GTree::clean();
+    });
+
+    mergeChunks(chunks, this -> _phenotype_values, this -> _phenotype_offsets);
+}
+
+size_t Population::getThreads() const { return this -> _threads; }
+
+void Population::setPhenotypeCache(PhenotypeCache* phenotype_cache) { this -> _phenotype_cache = phenotype_cache; }
+
+void Population::setThreads(size_t threads) {
+    this -> _threads = threads ? threads : std::max<unsigned int>(1, std::thread::hardware_concurrency());
+}
@@ -0,0 +1,63 @@
+#ifndef __GENOMUS_CORE_POPULATION__
+#define __GENOMUS_CORE_POPULATION__
+
+#include <span>
+#include <vector>
+
+#include "phenotype_cache.hpp"
+#include "specimen.hpp"
+
+/*
+    Population stores the stages of many specimens as structure of arrays: germinal vectors, normalized
+    vectors (encoded genotypes) and phenotype normalized vectors are each kept in one contiguous arena,
+    with an offset table per arena. Specimen k owns values [offsets[k], offsets[k + 1]) of each arena.
+
+    Stages are run in bulk with normalizeAll() and evaluateAll(), split into contiguous ranges of
+    specimens processed in parallel. Every thread works on its own GTree static data, and each specimen
+    is evaluated with GTree::RNG seeded with its seed, so results do not depend on the thread count.
+
+    An optional PhenotypeCache, that may be shared by several populations, lets evaluateAll() skip
+    parsing and evaluation for genotypes evaluated before.
+
+    Copying a population copies a handful of flat vectors, which makes whole population snapshots cheap.
+*/
+class Population {
+    private:
+        std::vector<double> _germinal_values;
+        std::vector<size_t> _germinal_offsets;
+        std::vector<double> _normalized_values;
+        std::vector<size_t> _normalized_offsets;
+        std::vector<double> _phenotype_values;
+        std::vector<size_t> _phenotype_offsets;
+        std::vector<size_t> _seeds;
+        size_t _threads;
+        PhenotypeCache* _phenotype_cache;
+    public:
+        // threads = 0 uses std::thread::hardware_concurrency()
+        Population(size_t threads = 0);
+
+        size_t add(std::span<const double> germinal_vector, size_t seed = SPECIMEN_DEFAULT_SEED);
+        void reserve(size_t specimens, size_t values_per_specimen);
+        void clear();
+        size_t size() const;
+
+        std::span<const double> getGerminalVector(size_t) const;
+        std::span<const double> getNormalizedVector(size_t) const;
+        std::span<const double> getPhenotypeVector(size_t) const;
+        size_t getSeed(size_t) const;
+        Specimen getSpecimen(size_t) const;
+
+        bool isNormalized() const;
+        bool isEvaluated() const;
+        // Both stages replace the results of previous runs
+        void normalizeAll();
+        // Normalizes the population first if needed
+        void evaluateAll();
+
+        size_t getThreads() const;
+        void setThreads(size_t);
+        // Not owned by the population. nullptr disables caching
+        void setPhenotypeCache(PhenotypeCache*);
+};
+
+#endif
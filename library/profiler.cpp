@@ -0,0 +1,257 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <vector>
+
+using profiler_clock = std::chrono::steady_clock;
+
+std::string Profiler::sectionToString(Section section) {
+    switch (section) {
+        case tree_node:
+            return "tree_node";
+        case function_compute:
+            return "function_compute";
+        default:
+            return "invalid_section";
+    }
+}
+
+#ifdef GENOMUS_PROFILING
+
+// Allocation counting. Replacing the global allocation functions is only done in profiling builds.
+
+static thread_local uint64_t thread_allocations = 0;
+
+void* operator new(std::size_t size) {
+    thread_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    thread_allocations++;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+    struct Frame {
+        Profiler::FunctionStats* stats;
+        profiler_clock::time_point start;
+        uint64_t start_allocations;
+        uint64_t children_ns;
+        uint64_t children_allocations;
+    };
+
+    struct ThreadProfile;
+
+    std::mutex registry_mutex;
+    std::vector<ThreadProfile*> registry;
+    Profiler::Report retired;
+
+    void merge(Profiler::Report& into, const Profiler::Report& from) {
+        for (auto& [key, stats] : from) {
+            auto& target = into[key];
+            target.calls += stats.calls;
+            target.inclusive_ns += stats.inclusive_ns;
+            target.exclusive_ns += stats.exclusive_ns;
+            target.inclusive_allocations += stats.inclusive_allocations;
+            target.exclusive_allocations += stats.exclusive_allocations;
+            for (size_t i = 0; i < PROFILER_HISTOGRAM_BUCKETS; ++i) {
+                target.inclusive_histogram[i] += stats.inclusive_histogram[i];
+                target.exclusive_histogram[i] += stats.exclusive_histogram[i];
+            }
+        }
+    }
+
+    // Statistics are kept per thread. The per thread mutex is only contended by snapshot and reset.
+    struct ThreadProfile {
+        std::mutex mutex;
+        Profiler::Report stats;
+        std::vector<Frame> frames;
+
+        ThreadProfile() {
+            frames.reserve(256);
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            registry.push_back(this);
+        }
+
+        ~ThreadProfile() {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            merge(retired, stats);
+            registry.erase(std::find(registry.begin(), registry.end(), this));
+        }
+    };
+
+    ThreadProfile& threadProfile() {
+        static thread_local ThreadProfile profile;
+        return profile;
+    }
+
+    size_t histogramBucket(uint64_t ns) {
+        return std::min<size_t>(std::bit_width(ns), PROFILER_HISTOGRAM_BUCKETS - 1);
+    }
+}
+
+void Profiler::enter(std::string_view name, Section section) {
+    ThreadProfile& profile = threadProfile();
+    FunctionStats* stats;
+    {
+        std::lock_guard<std::mutex> lock(profile.mutex);
+        auto it = profile.stats.find(KeyView{ name, section });
+        if (it == profile.stats.end()) {
+            it = profile.stats.emplace(Key{ std::string(name), section }, FunctionStats()).first;
+        }
+        stats = &it -> second;
+    }
+
+    profile.frames.push_back({
+        .stats = stats,
+        .start = profiler_clock::now(),
+        .start_allocations = thread_allocations,
+        .children_ns = 0,
+        .children_allocations = 0,
+    });
+}
+
+void Profiler::exit() {
+    const auto now = profiler_clock::now();
+    const uint64_t allocations = thread_allocations;
+    ThreadProfile& profile = threadProfile();
+
+    if (profile.frames.empty()) return;
+
+    Frame frame = profile.frames.back();
+    profile.frames.pop_back();
+
+    const uint64_t inclusive_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - frame.start).count();
+    const uint64_t exclusive_ns = inclusive_ns - std::min(inclusive_ns, frame.children_ns);
+    const uint64_t inclusive_allocations = allocations - frame.start_allocations;
+    const uint64_t exclusive_allocations = inclusive_allocations - std::min(inclusive_allocations, frame.children_allocations);
+
+    {
+        std::lock_guard<std::mutex> lock(profile.mutex);
+        FunctionStats& stats = *frame.stats;
+        stats.calls++;
+        stats.inclusive_ns += inclusive_ns;
+        stats.exclusive_ns += exclusive_ns;
+        stats.inclusive_allocations += inclusive_allocations;
+        stats.exclusive_allocations += exclusive_allocations;
+        stats.inclusive_histogram[histogramBucket(inclusive_ns)]++;
+        stats.exclusive_histogram[histogramBucket(exclusive_ns)]++;
+    }
+
+    if (!profile.frames.empty()) {
+        profile.frames.back().children_ns += inclusive_ns;
+        profile.frames.back().children_allocations += inclusive_allocations;
+    }
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    retired.clear();
+    for (ThreadProfile* profile : registry) {
+        std::lock_guard<std::mutex> profile_lock(profile -> mutex);
+        // Entries are zeroed instead of erased: open frames may point to them.
+        for (auto& [key, stats] : profile -> stats) stats = FunctionStats();
+    }
+}
+
+Profiler::Report Profiler::snapshot() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    Report result = retired;
+    for (ThreadProfile* profile : registry) {
+        std::lock_guard<std::mutex> profile_lock(profile -> mutex);
+        merge(result, profile -> stats);
+    }
+
+    for (auto it = result.begin(); it != result.end();) {
+        it = it -> second.calls ? std::next(it) : result.erase(it);
+    }
+
+    return result;
+}
+
+uint64_t Profiler::allocationCount() { return thread_allocations; }
+
+#else
+
+void Profiler::enter(std::string_view, Section) {}
+void Profiler::exit() {}
+void Profiler::reset() {}
+Profiler::Report Profiler::snapshot() { return {}; }
+uint64_t Profiler::allocationCount() { return 0; }
+
+#endif
+
+std::string Profiler::toTable() {
+    if (!enabled()) {
+        return "Profiling is not available: build with -DGENOMUS_PROFILING=ON\n";
+    }
+
+    const Report report = snapshot();
+    std::vector<std::pair<Key, FunctionStats>> rows(report.begin(), report.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+        return a.second.exclusive_ns > b.second.exclusive_ns;
+    });
+
+    std::stringstream ss;
+    ss << std::left << std::setw(24) << "function" << std::setw(18) << "section"
+       << std::right << std::setw(12) << "calls"
+       << std::setw(14) << "incl (ms)" << std::setw(14) << "excl (ms)" << std::setw(16) << "excl/call (ns)"
+       << std::setw(14) << "incl allocs" << std::setw(14) << "excl allocs" << '\n';
+
+    ss << std::fixed;
+    for (auto& [key, stats] : rows) {
+        ss << std::left << std::setw(24) << key.name << std::setw(18) << sectionToString(key.section)
+           << std::right << std::setw(12) << stats.calls
+           << std::setprecision(3) << std::setw(14) << stats.inclusive_ns / 1e6
+           << std::setw(14) << stats.exclusive_ns / 1e6
+           << std::setprecision(0) << std::setw(16) << (double)stats.exclusive_ns / stats.calls
+           << std::setw(14) << stats.inclusive_allocations << std::setw(14) << stats.exclusive_allocations << '\n';
+    }
+
+    return ss.str();
+}
+
+std::string Profiler::toJSON() {
+    const auto histogramToJSON = [](const Histogram& h) {
+        std::string result = "[";
+        for (size_t i = 0; i < h.size(); ++i) {
+            result += (i ? "," : "") + std::to_string(h[i]);
+        }
+        return result + "]";
+    };
+
+    std::stringstream ss;
+    ss << "{\"enabled\":" << (enabled() ? "true" : "false") << ",\"histogram_buckets\":\"log2_ns\",\"functions\":[";
+
+    bool first = true;
+    for (auto& [key, stats] : snapshot()) {
+        ss << (first ? "" : ",") << "{\"name\":\"" << key.name << "\""
+           << ",\"section\":\"" << sectionToString(key.section) << "\""
+           << ",\"calls\":" << stats.calls
+           << ",\"inclusive_ns\":" << stats.inclusive_ns
+           << ",\"exclusive_ns\":" << stats.exclusive_ns
+           << ",\"inclusive_allocations\":" << stats.inclusive_allocations
+           << ",\"exclusive_allocations\":" << stats.exclusive_allocations
+           << ",\"inclusive_histogram\":" << histogramToJSON(stats.inclusive_histogram)
+           << ",\"exclusive_histogram\":" << histogramToJSON(stats.exclusive_histogram) << "}";
+        first = false;
+    }
+
+    ss << "]}";
+    return ss.str();
+}
@@ -0,0 +1,112 @@
+#ifndef __GENOMUS_CORE_PROFILER__
+#define __GENOMUS_CORE_PROFILER__
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+/*
+    Profiler collects per GFunction statistics of the evaluation hot path: number of calls,
+    inclusive and exclusive time histograms and heap allocation counts.
+
+    Recording only happens when the library is compiled with GENOMUS_PROFILING defined
+    (cmake -DGENOMUS_PROFILING=ON). Otherwise the GENOMUS_PROFILE_* macros expand to nothing and
+    the reports are empty.
+
+    Two sections are recorded for every function: the GTree node evaluation (gathering of the
+    children, autoreference resolution) and the GFunction compute call itself. Exclusive values
+    of a section do not include any section nested inside it.
+*/
+
+#define PROFILER_HISTOGRAM_BUCKETS 32
+
+namespace Profiler {
+    enum Section {
+        tree_node,
+        function_compute,
+    };
+
+    struct Key {
+        std::string name;
+        Section section;
+    };
+
+    struct KeyView {
+        std::string_view name;
+        Section section;
+    };
+
+    // Orders keys by section and name, allowing lookups by KeyView without building a string.
+    struct KeyCompare {
+        using is_transparent = void;
+
+        template<typename A, typename B>
+        bool operator()(const A& a, const B& b) const {
+            if (a.section != b.section) return a.section < b.section;
+            return std::string_view(a.name) < std::string_view(b.name);
+        }
+    };
+
+    // Histogram bucket i counts calls that took [2^(i-1), 2^i) nanoseconds.
+    using Histogram = std::array<uint64_t, PROFILER_HISTOGRAM_BUCKETS>;
+
+    struct FunctionStats {
+        uint64_t calls = 0;
+        uint64_t inclusive_ns = 0;
+        uint64_t exclusive_ns = 0;
+        uint64_t inclusive_allocations = 0;
+        uint64_t exclusive_allocations = 0;
+        Histogram inclusive_histogram = {};
+        Histogram exclusive_histogram = {};
+    };
+
+    using Report = std::map<Key, FunctionStats, KeyCompare>;
+
+    constexpr bool enabled() {
+        #ifdef GENOMUS_PROFILING
+            return true;
+        #else
+            return false;
+        #endif
+    }
+
+    void enter(std::string_view name, Section section);
+    void exit();
+
+    // Clears the statistics of every thread.
+    void reset();
+
+    // Merges the statistics of every thread. Call it while no evaluation is running.
+    Report snapshot();
+
+    // Heap allocations performed by the calling thread so far (0 if compiled out).
+    uint64_t allocationCount();
+
+    std::string sectionToString(Section);
+    std::string toTable();
+    std::string toJSON();
+
+    class Scope {
+        public:
+            Scope(std::string_view name, Section section) { enter(name, section); }
+            ~Scope() { exit(); }
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+    };
+}
+
+#ifdef GENOMUS_PROFILING
+    #define GENOMUS_PROFILE_CONCAT_INNER(a, b) a##b
+    #define GENOMUS_PROFILE_CONCAT(a, b) GENOMUS_PROFILE_CONCAT_INNER(a, b)
+    #define GENOMUS_PROFILE_SCOPE(name, section) Profiler::Scope GENOMUS_PROFILE_CONCAT(_profile_scope_, __LINE__)(name, section)
+    #define GENOMUS_PROFILE_ENTER(name, section) Profiler::enter(name, section)
+    #define GENOMUS_PROFILE_EXIT() Profiler::exit()
+#else
+    #define GENOMUS_PROFILE_SCOPE(name, section) ((void)0)
+    #define GENOMUS_PROFILE_ENTER(name, section) ((void)0)
+    #define GENOMUS_PROFILE_EXIT() ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+#include "result.hpp"
+#include "errorCodes.hpp"
+
+#include <stdexcept>
+#include <string>
+
+const std::string& errorCodeToString(ErrorCodes::ErrorCode code) {
+    switch (code) {
+        case ErrorCodes::bad_gfunction_parameters: return ErrorCodes::BAD_GFUNCTION_PARAMETERS;
+        case ErrorCodes::bad_autoreference: return ErrorCodes::BAD_AUTOREFERENCE;
+        case ErrorCodes::bad_autoreference_index: return ErrorCodes::BAD_AUTOREFERENCE_INDEX;
+        case ErrorCodes::bad_parser_entry_bad_parenthesis: return ErrorCodes::BAD_PARSER_ENTRY_BAD_PARENTHESIS;
+        case ErrorCodes::bad_parser_entry_bad_function_name: return ErrorCodes::BAD_PARSER_ENTRY_BAD_FUNCTION_NAME;
+        case ErrorCodes::empty_germinal_vector: return ErrorCodes::EMPTY_GERMINAL_VECTOR;
+        case ErrorCodes::bad_normalized_vector_opening_marker: return ErrorCodes::BAD_NORMALIZED_VECTOR_OPENING_MARKER;
+        case ErrorCodes::bad_normalized_vector_function_index: return ErrorCodes::BAD_NORMALIZED_VECTOR_FUNCTION_INDEX;
+        case ErrorCodes::bad_normalized_vector_leaf_type_marker: return ErrorCodes::BAD_NORMALIZED_VECTOR_LEAF_TYPE_MARKER;
+        case ErrorCodes::bad_normalized_vector_closing_marker: return ErrorCodes::BAD_NORMALIZED_VECTOR_CLOSING_MARKER;
+        case ErrorCodes::bad_normalized_vector_truncated: return ErrorCodes::BAD_NORMALIZED_VECTOR_TRUNCATED;
+        case ErrorCodes::bad_normalized_vector_trailing_values: return ErrorCodes::BAD_NORMALIZED_VECTOR_TRAILING_VALUES;
+        default:
+            throw std::runtime_error(ErrorCodes::INVALID_ENUM_VALUE);
+    }
+}
+
+std::string errorToString(const GenomusError& error) {
+    const std::string position = std::to_string(error.position);
+
+    switch (error.code) {
+        // Normalized vectors keep the messages toExpression has always thrown
+        case ErrorCodes::bad_normalized_vector_opening_marker:
+            return "Expected 1.0 at position " + position;
+        case ErrorCodes::bad_normalized_vector_function_index:
+            return "Expected a function index of the expected type at position " + position;
+        case ErrorCodes::bad_normalized_vector_leaf_type_marker:
+            return "Expected formatted parameter type at position " + position;
+        case ErrorCodes::bad_normalized_vector_closing_marker:
+            return "Expected 0 at position " + position;
+        case ErrorCodes::bad_normalized_vector_truncated:
+            return "Unexpected end of the vector at position " + position;
+        case ErrorCodes::bad_normalized_vector_trailing_values:
+            return "Unexpected values after the genotype at position " + position;
+        case ErrorCodes::bad_gfunction_parameters:
+            return errorCodeToString(error.code) + ": " + std::string(error.function)
+                + " does not match its arguments at position " + position + ".";
+        default:
+            break;
+    }
+
+    if (error.function.empty()) return errorCodeToString(error.code);
+    return errorCodeToString(error.code) + ": " + std::string(error.function);
+}
@@ -0,0 +1,66 @@
+#ifndef __GENOMUS_CORE_RESULT__
+#define __GENOMUS_CORE_RESULT__
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+
+#include "errorCodes.hpp"
+
+/*
+    GenomusError tells why an operation of the non-throwing API failed and where. Errors are plain
+    values: building, returning or discarding one never allocates, so rejecting a malformed input
+    costs about as much as reading it.
+
+    The position depends on the input: the character of a parsed expression, the value of a vector
+    or the node of a tree, as each function documents.
+*/
+struct GenomusError {
+    ErrorCodes::ErrorCode code;
+    size_t position;
+    // Function involved, if any: a library function name, or the unknown name as written in a parsed entry
+    std::string_view function;
+};
+
+const std::string& errorCodeToString(ErrorCodes::ErrorCode);
+// Same messages the throwing API uses
+std::string errorToString(const GenomusError&);
+
+/*
+    Result holds either the value of an operation or the GenomusError that prevented it, as
+    std::expected does from C++23 on. The throwing functions of the library are wrappers that
+    call valueOrThrow() on the Result of their non-throwing version.
+*/
+template<typename T>
+class Result {
+    private:
+        std::variant<T, GenomusError> _value;
+    public:
+        Result(T value) : _value(std::in_place_index<0>, std::move(value)) {}
+        Result(GenomusError error) : _value(std::in_place_index<1>, error) {}
+
+        bool hasValue() const { return this -> _value.index() == 0; }
+        explicit operator bool() const { return this -> hasValue(); }
+
+        // Only valid for results holding a value
+        T& value() { return *std::get_if<0>(&this -> _value); }
+        const T& value() const { return *std::get_if<0>(&this -> _value); }
+        T& operator*() { return this -> value(); }
+        const T& operator*() const { return this -> value(); }
+        T* operator->() { return &this -> value(); }
+        const T* operator->() const { return &this -> value(); }
+
+        // Only valid for results holding an error
+        const GenomusError& error() const { return *std::get_if<1>(&this -> _value); }
+
+        // The value, or the error thrown as a std::runtime_error
+        T valueOrThrow() && {
+            if (!this -> hasValue()) throw std::runtime_error(errorToString(this -> error()));
+            return std::move(this -> value());
+        }
+};
+
+#endif
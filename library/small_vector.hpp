@@ -0,0 +1,168 @@
+#ifndef __GENOMUS_CORE_SMALL_VECTOR__
+#define __GENOMUS_CORE_SMALL_VECTOR__
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <memory>
+#include <new>
+#include <span>
+#include <utility>
+
+/*
+    SmallVector is a vector with inline storage for its first N elements. It only allocates
+    on the heap once it grows beyond N, which never happens for the children of most GTree
+    nodes or for function signatures: the maximum arity in the function library is 4.
+
+    Only the subset of the std::vector interface used by the library is provided.
+*/
+
+template<typename T, size_t N>
+class SmallVector {
+    private:
+        alignas(T) std::byte _inline_storage[N * sizeof(T)];
+        T* _data;
+        size_t _size;
+        size_t _capacity;
+
+        T* inlineData() { return reinterpret_cast<T*>(this -> _inline_storage); }
+        bool isInline() const { return this -> _data == reinterpret_cast<const T*>(this -> _inline_storage); }
+
+        void grow(size_t min_capacity) {
+            const size_t new_capacity = std::max(min_capacity, this -> _capacity * 2);
+            T* new_data = static_cast<T*>(::operator new(new_capacity * sizeof(T), std::align_val_t(alignof(T))));
+            std::uninitialized_move(this -> _data, this -> _data + this -> _size, new_data);
+            std::destroy(this -> _data, this -> _data + this -> _size);
+            this -> releaseStorage();
+            this -> _data = new_data;
+            this -> _capacity = new_capacity;
+        }
+
+        void releaseStorage() {
+            if (!this -> isInline()) {
+                ::operator delete(this -> _data, std::align_val_t(alignof(T)));
+            }
+        }
+
+    public:
+        using value_type = T;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        SmallVector() : _data(inlineData()), _size(0), _capacity(N) {}
+
+        SmallVector(std::initializer_list<T> init) : SmallVector() {
+            this -> assign(init.begin(), init.end());
+        }
+
+        template<typename InputIt>
+        SmallVector(InputIt first, InputIt last) : SmallVector() {
+            this -> assign(first, last);
+        }
+
+        SmallVector(std::span<const T> values) : SmallVector() {
+            this -> assign(values.begin(), values.end());
+        }
+
+        SmallVector(const SmallVector& other) : SmallVector() {
+            this -> assign(other.begin(), other.end());
+        }
+
+        SmallVector(SmallVector&& other) noexcept : SmallVector() {
+            *this = std::move(other);
+        }
+
+        ~SmallVector() {
+            this -> clear();
+            this -> releaseStorage();
+        }
+
+        SmallVector& operator=(const SmallVector& other) {
+            if (this != &other) {
+                this -> assign(other.begin(), other.end());
+            }
+            return *this;
+        }
+
+        SmallVector& operator=(SmallVector&& other) noexcept {
+            if (this == &other) return *this;
+
+            this -> clear();
+            if (other.isInline()) {
+                std::uninitialized_move(other.begin(), other.end(), this -> _data);
+                this -> _size = other._size;
+                other.clear();
+            } else {
+                // Steal the heap buffer
+                this -> releaseStorage();
+                this -> _data = other._data;
+                this -> _size = other._size;
+                this -> _capacity = other._capacity;
+                other._data = other.inlineData();
+                other._size = 0;
+                other._capacity = N;
+            }
+            return *this;
+        }
+
+        template<typename InputIt>
+        void assign(InputIt first, InputIt last) {
+            this -> clear();
+            for (; first != last; ++first) {
+                this -> push_back(*first);
+            }
+        }
+
+        void reserve(size_t capacity) {
+            if (capacity > this -> _capacity) this -> grow(capacity);
+        }
+
+        void push_back(const T& value) { this -> emplace_back(value); }
+        void push_back(T&& value) { this -> emplace_back(std::move(value)); }
+
+        template<typename... Args>
+        T& emplace_back(Args&&... args) {
+            if (this -> _size == this -> _capacity) {
+                // Construct first: args may reference an element of this vector
+                T value(std::forward<Args>(args)...);
+                this -> grow(this -> _size + 1);
+                return *new (this -> _data + this -> _size++) T(std::move(value));
+            }
+            return *new (this -> _data + this -> _size++) T(std::forward<Args>(args)...);
+        }
+
+        void pop_back() {
+            std::destroy_at(this -> _data + --this -> _size);
+        }
+
+        void clear() {
+            std::destroy(this -> _data, this -> _data + this -> _size);
+            this -> _size = 0;
+        }
+
+        size_t size() const { return this -> _size; }
+        size_t capacity() const { return this -> _capacity; }
+        bool empty() const { return this -> _size == 0; }
+
+        T* data() { return this -> _data; }
+        const T* data() const { return this -> _data; }
+
+        T& operator[](size_t i) { return this -> _data[i]; }
+        const T& operator[](size_t i) const { return this -> _data[i]; }
+        T& back() { return this -> _data[this -> _size - 1]; }
+        const T& back() const { return this -> _data[this -> _size - 1]; }
+
+        iterator begin() { return this -> _data; }
+        iterator end() { return this -> _data + this -> _size; }
+        const_iterator begin() const { return this -> _data; }
+        const_iterator end() const { return this -> _data + this -> _size; }
+
+        operator std::span<T>() { return { this -> _data, this -> _size }; }
+        operator std::span<const T>() const { return { this -> _data, this -> _size }; }
+
+        bool operator==(const SmallVector& other) const {
+            return std::equal(this -> begin(), this -> end(), other.begin(), other.end());
+        }
+};
+
+#endif
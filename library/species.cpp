@@ -1,60 +1,51 @@
 #include "species.hpp"
-#include "encoded_phenotype.hpp"
-#include <algorithm>
+#include "errorCodes.hpp"
 #include <stdexcept>
 
-std::string ParameterTypeToString(ParameterType pt) {
-    switch (pt) {
-        case duration:
-            return "duration";
-        case pitch:
-            return "pitch";
-        case articulation:
-            return "articulation";
-        case intensity:
-            return "intensity";
-        default:
-            char* error_message;
-            snprintf(error_message, 50, "Invalid event parameter type: %d", (int)pt);
-            throw std::runtime_error(error_message);
-    }
-}
-
-Species::Species() {
-    this -> _name = "default species";
-    this -> _parameter_types = {};
-}
-
 Species::Species(SpeciesInitializer init) {
     if (!init.name.length()) {
         throw std::runtime_error("Cannot asign empty name to species.");
     }
 
-    if (!init.parameter_types.size()) {
-        throw std::runtime_error("Cannot assign empty parameter types vector to species.");
+    if (!init.event_fields.size()) {
+        throw std::runtime_error("Cannot assign empty event fields to species.");
     }
 
     this -> _name = init.name;
-    this -> _parameter_types = init.parameter_types;
+    this -> _event_fields = init.event_fields;
+    this -> _event_function_name = init.event_function_name;
 }
 
-std::vector<ParameterType> Species::getParameterTypes() { return this -> _parameter_types; }
+const std::string& Species::getName() const { return this -> _name; }
+std::span<const EncodedPhenotypeType> Species::getEventFields() const { return this -> _event_fields; }
+size_t Species::getFieldCount() const { return this -> _event_fields.size(); }
+const std::string& Species::getEventFunctionName() const { return this -> _event_function_name; }
 
-std::string Species::toString() {
+std::string Species::toString() const {
     std::string ret = "---SPECIES---";
     ret += "\n\t_name: " + this -> _name;
-    ret += "\n\t_parameter_types: (";
-    
-    for_each(this -> _parameter_types.begin(), this -> _parameter_types.end(), [&](ParameterType pt) {
-        ret += ParameterTypeToString(pt) + ", ";
-    });
+    ret += "\n\t_event_function_name: " + this -> _event_function_name;
+    ret += "\n\t_event_fields: (";
+
+    for (auto field : this -> _event_fields) {
+        ret += encodedPhenotypeTypeToString(field) + ", ";
+    }
 
     return ret.substr(0, ret.length() - 2) + ")";
 }
 
-Species piano = Species({
-    .name = "piano",
-    .parameter_types = { noteValue, duration, pitch, intensity}
-});
+EncodedPhenotype Species::Event(std::vector<EncodedPhenotype> parameters) const {
+    if (parameters.size() != this -> _event_fields.size()) {
+        throw std::runtime_error(ErrorCodes::BAD_ENC_PHEN_CONSTRUCTION_BAD_CHILD_TYPE + ": " + this -> _name + " events have " + std::to_string(this -> _event_fields.size()) + " fields");
+    }
+
+    for (size_t k = 0; k < parameters.size(); ++k) {
+        if (parameters[k].getType() != this -> _event_fields[k]) {
+            throw std::runtime_error(ErrorCodes::BAD_ENC_PHEN_CONSTRUCTION_BAD_CHILD_TYPE + ": " + this -> _name + " event field " + std::to_string(k) + " must be " + encodedPhenotypeTypeToString(this -> _event_fields[k]));
+        }
+    }
+
+    return EventFrom(parameters);
+}
 
-Species CURRENT_SPECIES = piano;
\ No newline at end of file
+const Species piano = Species::fromLayout<PianoEventLayout>("piano", "e_piano");
@@ -1,39 +1,79 @@
 #ifndef __GENOMUS_CORE_SPECIES__
 #define __GENOMUS_CORE_SPECIES__ 
 
+#include <array>
+#include <cstddef>
+#include <span>
 #include <string>
 #include <vector>
 
-enum ParameterType {
-    noteValue,
-    duration,
-    pitch,
-    articulation,
-    intensity,
-};
+#include "encoded_phenotype.hpp"
+
+/*
+    EventLayout describes at compile time the events of a species: the parameter type of each field, in order.
+    Field offsets are constants, so code written for a species reads an event field by position, without
+    looking for it: event.getChildren()[PianoEventLayout::offset<midiPitchF>].
+*/
+template<EncodedPhenotypeType... Fields>
+struct EventLayout {
+    static_assert(sizeof...(Fields) > 0, "Events need at least one field.");
+    static_assert(((Fields >= noteValueF && Fields <= quantizedF) && ...), "Event fields must be parameter types.");
 
-std::string ParameterTypeToString(ParameterType);
+    static constexpr size_t field_count = sizeof...(Fields);
+    static constexpr std::array<EncodedPhenotypeType, field_count> fields = { Fields... };
 
+    private:
+        // Not a constant expression for missing fields, so they fail to compile
+        static consteval size_t _offset(EncodedPhenotypeType field) {
+            for (size_t k = 0; k < field_count; ++k) {
+                if (fields[k] == field) return k;
+            }
+            throw "Field not found in event layout";
+        }
+    public:
+        template<EncodedPhenotypeType Field>
+        static constexpr size_t offset = _offset(Field);
+};
+
+/*
+    A species defines the events of its phenotypes: their layout and the function of the grammar that builds
+    them. Species are plain values built from a layout, so several species can be used side by side.
+*/
 class Species {
     struct SpeciesInitializer {
         std::string name;
-        std::vector<ParameterType> parameter_types;
+        std::span<const EncodedPhenotypeType> event_fields;
+        std::string event_function_name;
     };
 
     private:
         std::string _name;
-        std::vector<ParameterType> _parameter_types;
+        std::span<const EncodedPhenotypeType> _event_fields;
+        std::string _event_function_name;
     public:
-        Species();
         Species(SpeciesInitializer);
-        std::string getName();
-        std::vector<ParameterType> getParameterTypes();
-        std::string toString();
+
+        template<typename Layout>
+        static Species fromLayout(std::string name, std::string event_function_name) {
+            return Species({
+                .name = name,
+                .event_fields = Layout::fields,
+                .event_function_name = event_function_name,
+            });
+        }
+
+        const std::string& getName() const;
+        std::span<const EncodedPhenotypeType> getEventFields() const;
+        size_t getFieldCount() const;
+        const std::string& getEventFunctionName() const;
+        std::string toString() const;
+
+        // Event, checked against the species layout
+        EncodedPhenotype Event(std::vector<EncodedPhenotype> parameters) const;
 };
 
-extern Species CURRENT_SPECIES,
-    piano;
+using PianoEventLayout = EventLayout<noteValueF, midiPitchF, articulationF, intensityF>;
 
-void usePianoSpecies();
+extern const Species piano;
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,61 @@
+#include "specimen.hpp"
+#include "parser.hpp"
+
+Specimen::Specimen(enc_gen_t germinal_vector, size_t seed)
+    : _germinal_vector(std::move(germinal_vector)), _seed(seed), _context(std::make_unique<GTree::Context>()) {
+    this -> _context -> RNG.seed(seed);
+}
+
+Specimen& Specimen::operator=(Specimen&& other) {
+    if (this == &other) return *this;
+
+    this -> _encoded_phenotype.reset();
+    this -> _decoded_genotype.reset();
+
+    this -> _germinal_vector = std::move(other._germinal_vector);
+    this -> _seed = other._seed;
+    this -> _context = std::move(other._context);
+    this -> _encoded_genotype = std::move(other._encoded_genotype);
+    this -> _decoded_genotype = std::move(other._decoded_genotype);
+    this -> _encoded_phenotype = std::move(other._encoded_phenotype);
+
+    return *this;
+}
+
+const enc_gen_t& Specimen::getEncodedGenotype() {
+    if (!this -> _encoded_genotype) {
+        enc_gen_t normalized;
+        normalizeVector(this -> _germinal_vector, normalized);
+        this -> _encoded_genotype = std::move(normalized);
+    }
+
+    return *this -> _encoded_genotype;
+}
+
+dec_gen_t Specimen::getDecodedGenotype() {
+    if (!this -> _decoded_genotype) {
+        const std::string expression = toExpression(this -> getEncodedGenotype());
+
+        GTree::Context::Scope scope(*this -> _context);
+        this -> _decoded_genotype = parseString(expression);
+    }
+
+    return *this -> _decoded_genotype;
+}
+
+const enc_phen_t& Specimen::getEncodedPhenotype() {
+    if (!this -> _encoded_phenotype) {
+        dec_gen_t decoded_genotype = this -> getDecodedGenotype();
+
+        GTree::Context::Scope scope(*this -> _context);
+        this -> _encoded_phenotype.emplace(decoded_genotype.evaluate(GTree::phenotype_arena));
+    }
+
+    return *this -> _encoded_phenotype;
+}
+
+GTree::Context& Specimen::getContext() { return *this -> _context; }
+size_t Specimen::getSeed() const { return this -> _seed; }
+bool Specimen::hasEncodedGenotype() const { return this -> _encoded_genotype.has_value(); }
+bool Specimen::hasDecodedGenotype() const { return this -> _decoded_genotype.has_value(); }
+bool Specimen::hasEncodedPhenotype() const { return this -> _encoded_phenotype.has_value(); }
@@ -1,26 +1,51 @@
 #ifndef __GENOMUS_CORE_SPECIMEN__
-#define __GENOMUS_CORE_SPECIMEN__ 
+#define __GENOMUS_CORE_SPECIMEN__
 
+#include <memory>
+#include <optional>
 #include <vector>
 
 #include "encoded_genotype.hpp"
 #include "decoded_genotype.hpp"
 #include "encoded_phenotype.hpp"
 
-using namespace std;
+#define SPECIMEN_DEFAULT_SEED 0
 
+/*
+    Specimen follows a genotype through the genomus pipeline: encoded genotype (normalized vector),
+    decoded genotype (GTree) and encoded phenotype. Each stage is computed on first access and cached,
+    so a specimen only pays for the stages that are actually read.
+
+    The decoded genotype and the encoded phenotype live in a GTree::Context owned by the specimen,
+    with its own phenotype arena and an RNG seeded with the specimen seed. They are not affected by
+    GTree::clean(), and random functions evaluate the same way for the same seed.
+*/
 class Specimen {
     private:
-        enc_gen_t _encoded_genotype;
-        dec_gen_t _decoded_genotype;
-        enc_phen_t _encoded_phenotype;
-        int _decoded_phenotype;
+        enc_gen_t _germinal_vector;
+        size_t _seed;
+        // Declared before the stages: cached phenotypes are stored in its arena
+        std::unique_ptr<GTree::Context> _context;
+
+        std::optional<enc_gen_t> _encoded_genotype;
+        std::optional<dec_gen_t> _decoded_genotype;
+        std::optional<enc_phen_t> _encoded_phenotype;
     public:
-        Specimen(enc_gen_t);
-        enc_gen_t getEncodedGenotype();
+        Specimen(enc_gen_t, size_t seed = SPECIMEN_DEFAULT_SEED);
+        Specimen(Specimen&&) = default;
+        // Releases the cached stages before the context they are stored in
+        Specimen& operator=(Specimen&&);
+
+        const enc_gen_t& getEncodedGenotype();
+        // Index into getContext(): use it within a GTree::Context::Scope of the specimen context
         dec_gen_t getDecodedGenotype();
-        enc_phen_t getEncodedPhenotype();
-        int getDecodedPhenotype();
+        const enc_phen_t& getEncodedPhenotype();
+
+        GTree::Context& getContext();
+        size_t getSeed() const;
+        bool hasEncodedGenotype() const;
+        bool hasDecodedGenotype() const;
+        bool hasEncodedPhenotype() const;
 };
 
-#endif
\ No newline at end of file
+#endif
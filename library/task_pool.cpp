@@ -0,0 +1,127 @@
+#include "task_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+struct TaskPool::Group {
+    std::atomic<size_t> remaining;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
+
+// Pool and queue of the worker running on the calling thread, if any
+static thread_local const TaskPool* worker_pool = nullptr;
+static thread_local size_t worker_queue = 0;
+
+TaskPool::TaskPool(size_t threads) : _queued(0), _stopping(false) {
+    if (!threads) threads = std::max<unsigned int>(1, std::thread::hardware_concurrency());
+
+    for (size_t k = 0; k < threads + 1; ++k) {
+        this -> _queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (size_t k = 0; k < threads; ++k) {
+        this -> _workers.emplace_back([this, k]() { this -> _work(k); });
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(this -> _idle_mutex);
+        this -> _stopping = true;
+    }
+    this -> _idle_condition.notify_all();
+    for (auto& worker : this -> _workers) worker.join();
+}
+
+size_t TaskPool::getThreads() const { return this -> _workers.size(); }
+
+size_t TaskPool::_ownQueue() const {
+    return worker_pool == this ? worker_queue : this -> _workers.size();
+}
+
+// Pops the newest task of the own queue, or steals the oldest task of another one
+bool TaskPool::_runPending(size_t own_queue) {
+    for (size_t k = 0; k < this -> _queues.size(); ++k) {
+        const size_t queue_index = (own_queue + k) % this -> _queues.size();
+        Queue& queue = *this -> _queues[queue_index];
+
+        std::unique_lock<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        Task task;
+        if (queue_index == own_queue) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        } else {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        lock.unlock();
+
+        this -> _queued--;
+        this -> _run(task);
+        return true;
+    }
+    return false;
+}
+
+void TaskPool::_run(Task task) {
+    try {
+        (*task.body)(task.index);
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(task.group -> error_mutex);
+        if (!task.group -> error) task.group -> error = std::current_exception();
+    }
+    task.group -> remaining--;
+}
+
+void TaskPool::_work(size_t queue) {
+    worker_pool = this;
+    worker_queue = queue;
+
+    while (true) {
+        if (this -> _runPending(queue)) continue;
+
+        std::unique_lock<std::mutex> lock(this -> _idle_mutex);
+        this -> _idle_condition.wait(lock, [this]() { return this -> _stopping || this -> _queued > 0; });
+        if (this -> _stopping) return;
+    }
+}
+
+void TaskPool::forEach(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+
+    if (count == 1 || this -> _workers.empty()) {
+        for (size_t k = 0; k < count; ++k) task(k);
+        return;
+    }
+
+    Group group;
+    group.remaining = count;
+
+    // Counted before they are pushed, so the count never drops below the queued tasks
+    {
+        std::lock_guard<std::mutex> lock(this -> _idle_mutex);
+        this -> _queued += count - 1;
+    }
+
+    const size_t own_queue = this -> _ownQueue();
+    {
+        Queue& queue = *this -> _queues[own_queue];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        // Pushed in reverse, so the own thread pops them in order
+        for (size_t k = count; k-- > 1;) {
+            queue.tasks.push_back({ .body = &task, .index = k, .group = &group });
+        }
+    }
+    this -> _idle_condition.notify_all();
+
+    this -> _run({ .body = &task, .index = 0, .group = &group });
+
+    while (group.remaining > 0) {
+        if (!this -> _runPending(own_queue)) std::this_thread::yield();
+    }
+
+    if (group.error) std::rethrow_exception(group.error);
+}
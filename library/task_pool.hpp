@@ -0,0 +1,62 @@
+#ifndef __GENOMUS_CORE_TASK_POOL__
+#define __GENOMUS_CORE_TASK_POOL__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    TaskPool is a fork-join pool of worker threads with work stealing. Every worker owns a deque of tasks:
+    tasks forked by a worker are pushed to and popped from the back of its own deque, and idle workers steal
+    from the front of the others. Threads outside the pool share one more deque.
+
+    forEach() forks a task per index and waits for all of them. A waiting thread runs pending tasks meanwhile,
+    so tasks may fork and wait for nested tasks without blocking the pool.
+*/
+class TaskPool {
+    private:
+        struct Group;
+        struct Task {
+            const std::function<void(size_t)>* body;
+            size_t index;
+            Group* group;
+        };
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        // One queue per worker, followed by the queue of threads outside the pool
+        std::vector<std::unique_ptr<Queue>> _queues;
+        std::vector<std::thread> _workers;
+
+        std::mutex _idle_mutex;
+        std::condition_variable _idle_condition;
+        // Tasks pushed and not taken yet, so idle workers know when to wake up
+        std::atomic<size_t> _queued;
+        bool _stopping;
+
+        size_t _ownQueue() const;
+        bool _runPending(size_t own_queue);
+        void _run(Task);
+        void _work(size_t queue);
+    public:
+        // threads = 0 uses std::thread::hardware_concurrency()
+        TaskPool(size_t threads = 0);
+        ~TaskPool();
+        TaskPool(const TaskPool&) = delete;
+        TaskPool& operator=(const TaskPool&) = delete;
+
+        size_t getThreads() const;
+
+        // Runs task(k) for k in [0, count), possibly in parallel, and returns when every task is done.
+        // The first exception thrown by a task is rethrown.
+        void forEach(size_t count, const std::function<void(size_t)>& task);
+};
+
+#endif
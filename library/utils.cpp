@@ -1,8 +1,10 @@
 #include "utils.hpp"
+#include "expression_writer.hpp"
 #include <cstdint>
 #include <iostream>
+#include <mutex>
 #include <ostream>
-#include <sstream>
+#include <set>
 
 std::string join(std::vector<std::string> arg, std::string separator) {
     std::string result = "";
@@ -14,36 +16,34 @@ std::string join(std::vector<std::string> arg, std::string separator) {
     return result.substr(0, result.length() - separator.length());
 }
 
-std::string repeat(std::string s, int n) {
-    std::stringstream result;
- 
-    for (int i = 0; i < n; i++) result << s;
- 
-    return result.str();
-}
-
 std::string prettyPrint(std::string s) {
-    std::stringstream result;
-    std::string tab = "    ";
-    unsigned int current_indentation = 0;
+    std::string result;
+    size_t current_indentation = 0;
 
-    std::string pre = "", post = "";
+    const auto newLine = [&]() {
+        result += '\n';
+        for (size_t k = 0; k < current_indentation; ++k) result += EXPRESSION_INDENTATION;
+    };
+
+    result.reserve(2 * s.size());
 
     for (char c: s) {
         if (c == '(') {
             ++current_indentation;
-            result << c << '\n' << repeat(tab, current_indentation);
+            result += c;
+            newLine();
         } else if (c == ')') {
             if (current_indentation > 0) {
                 --current_indentation;
             }
-            result << '\n' << repeat(tab, current_indentation) << c;
+            newLine();
+            result += c;
         } else {
-            result << c;
+            result += c;
         }
     }
 
-    return result.str();
+    return result;
 }
 
 double roundTo6Decimals(double f) {
@@ -51,9 +51,16 @@ double roundTo6Decimals(double f) {
 }
 
 std::map<double, size_t> _normalizedToInteger;
+// Guards _normalizedToInteger: integers are decoded concurrently by parallel population stages
+static std::mutex normalized_to_integer_mutex;
+
+double encodeInteger(size_t x) {
+    return roundTo6Decimals(PHI * x - (int)(PHI * x));
+}
 
 double integerToNormalized(size_t x) {
-    const double encoded = roundTo6Decimals(PHI * x - (int)(PHI * x));
+    const double encoded = encodeInteger(x);
+    std::lock_guard<std::mutex> lock(normalized_to_integer_mutex);
     _normalizedToInteger[encoded] = x;
     return encoded;
 }
@@ -61,6 +68,7 @@ double integerToNormalized(size_t x) {
 size_t normalizedToInteger(double x) {
     static const size_t max_encodable_integer = 100;
     static size_t max_explored_integer = 0;
+    std::lock_guard<std::mutex> lock(normalized_to_integer_mutex);
     if (_normalizedToInteger.find(x) != _normalizedToInteger.end()) {
         return _normalizedToInteger[x];
     }
@@ -68,7 +76,9 @@ size_t normalizedToInteger(double x) {
     // search for result in interval [0, max_encodable_integer]
     size_t result;
     for (size_t i = max_explored_integer; i < max_encodable_integer; i++) {
-        if (integerToNormalized(i) == roundTo6Decimals(x)) {
+        const double encoded = encodeInteger(i);
+        _normalizedToInteger[encoded] = i;
+        if (encoded == roundTo6Decimals(x)) {
             max_explored_integer = i;
             return i;
         }
@@ -82,14 +92,22 @@ size_t normalizedToInteger(double x) {
 std::string strip(std::string& str){
     auto start_it = str.begin();
     auto end_it = str.rbegin();
-    while (std::isspace(*start_it))
+    while (start_it != str.end() && std::isspace(*start_it))
         ++start_it;
+    if (start_it == str.end())
+        return "";
     while (std::isspace(*end_it))
         ++end_it;
     return std::string(start_it, end_it.base());
 }
 
 
+std::string_view internString(const std::string& str) {
+    static std::mutex interned_strings_mutex;
+    static std::set<std::string> interned_strings;
+    std::lock_guard<std::mutex> lock(interned_strings_mutex);
+    return *interned_strings.insert(str).first;
+}
 
 ////////////////
 //            //
@@ -113,6 +131,7 @@ RandomGenerator::RandomGenerator() {
     this -> _seed = time(NULL);
     this -> _next = mulberry_32_next;
     this -> _max = mulberry_32_max;
+    this -> _draws = 0;
 }
 
 void RandomGenerator::seed(size_t s) {
@@ -122,9 +141,12 @@ void RandomGenerator::seed(size_t s) {
 size_t RandomGenerator::next() {
     size_t next = this -> _next(this -> _seed);
     this -> _seed = next;
+    this -> _draws++;
     return next;
 }
 
+size_t RandomGenerator::getDraws() const { return this -> _draws; }
+
 double RandomGenerator::nextDouble() {
     return ((double)this -> next()) / ((double)this -> _max);
 }
\ No newline at end of file
@@ -2,13 +2,16 @@
 #define __GENOMUS_CORE_UTILS__ 
 
 #include <algorithm>
+#include <exception>
 #include <functional>
 #include <math.h>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <sstream>
+#include <thread>
 
 static const double E = exp(1.0);
 static const double PHI = (1 + sqrt(5)) / 2;
@@ -61,6 +64,8 @@ T findWithDefault(const std::map<K, T>& m, K k, T def_val) {
     return it -> second;
 }
 
+// Same value as integerToNormalized, without registering it for normalizedToInteger
+double encodeInteger(size_t x);
 double integerToNormalized(size_t x);
 size_t normalizedToInteger(double x);
 
@@ -86,8 +91,11 @@ std::vector<T>& operator+=(std::vector<T>& a, T b) {
 
 std::string strip(std::string&);
 
+// Returns a view of a stored copy of the string, valid for the whole program execution
+std::string_view internString(const std::string&);
+
 template<typename K, typename T>
-K getClosestKey(std::map<K, T> m, K k) {
+K getClosestKey(const std::map<K, T>& m, K k) {
     const K upper = m.upper_bound(k) -> first; 
     const K lower = m.lower_bound(k) -> first; 
     const K upper_dif = upper - k;
@@ -96,17 +104,16 @@ K getClosestKey(std::map<K, T> m, K k) {
     return upper_dif < lower_dif ? upper : lower;
 }
 
+// Same as getClosestValue for an already sorted vector, without copying it
 template<typename T>
-T getClosestValue(std::vector<T> v, T val, bool ignore_actual_closest = false) {
+T getClosestValueSorted(const std::vector<T>& v, T val, bool ignore_actual_closest = false) {
     if (!v.size()) {
-        throw new std::runtime_error("Vector must have elements");
+        throw std::runtime_error("Vector must have elements");
     }
 
     if (ignore_actual_closest && v.size() < 2) {
-        throw new std::runtime_error("Vector must have two elements to ignore closest");
+        throw std::runtime_error("Vector must have two elements to ignore closest");
     }
-    
-    sort(v.begin(), v.end());
 
     auto it = v.begin();
     for (it = v.begin(); it != v.end(); ++it) {
@@ -136,6 +143,43 @@ T getClosestValue(std::vector<T> v, T val, bool ignore_actual_closest = false) {
     return ((val - *previous) > (*it - val)) ? *it : *previous;
 }
 
+template<typename T>
+T getClosestValue(std::vector<T> v, T val, bool ignore_actual_closest = false) {
+    sort(v.begin(), v.end());
+    return getClosestValueSorted(v, val, ignore_actual_closest);
+}
+
+// Splits [0, size) into contiguous chunks and runs task(chunk, begin, end) for each one on its own thread.
+// The first exception thrown by a task is rethrown on the calling thread once every thread has finished.
+template<typename Task>
+void parallelChunks(size_t size, size_t chunks, Task task) {
+    chunks = std::max<size_t>(1, std::min(chunks, size));
+
+    if (chunks == 1) {
+        task(0, 0, size);
+        return;
+    }
+
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> threads;
+    threads.reserve(chunks);
+
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        threads.emplace_back([&, chunk]() {
+            try {
+                task(chunk, size * chunk / chunks, size * (chunk + 1) / chunks);
+            } catch (...) {
+                errors[chunk] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto& thread : threads) thread.join();
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
 ////////////////
 //            //
 //    RNG!    //
@@ -147,12 +191,15 @@ class RandomGenerator {
         std::function<size_t(size_t)> _next;
         size_t _seed;
         size_t _max;
+        size_t _draws;
     public:
         RandomGenerator();
         // RandomGenerator(size_t, std::function<size_t(size_t)>);
         void seed(size_t);
         size_t next();
         double nextDouble();
+        // Number of values drawn so far, to find out whether some computation depends on the generator
+        size_t getDraws() const;
 };
 
 uint32_t mulberry_32(uint32_t);
@@ -0,0 +1,65 @@
+#include <csignal>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "server.hpp"
+
+#define DEFAULT_SOCKET_PATH "/tmp/genomus.sock"
+
+static const std::string USAGE =
+    "Usage: genomus-server [--socket PATH] [--threads N] [--max-frame-size BYTES]\n"
+    "    --socket PATH             UNIX domain socket to listen on (default: " DEFAULT_SOCKET_PATH ")\n"
+    "    --threads N               Evaluation workers (default: every hardware thread)\n"
+    "    --max-frame-size BYTES    Largest accepted frame (default: " + std::to_string(SERVER_DEFAULT_MAX_FRAME_SIZE) + ")\n";
+
+static Server* running_server = nullptr;
+
+static void handleSignal(int) {
+    if (running_server) running_server -> stop();
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    ServerOptions options = { .socket_path = DEFAULT_SOCKET_PATH };
+
+    try {
+        for (size_t k = 0; k < args.size(); ++k) {
+            if (args[k] == "--socket" && k + 1 < args.size()) {
+                options.socket_path = args[++k];
+            } else if (args[k] == "--threads" && k + 1 < args.size()) {
+                options.threads = std::stoul(args[++k]);
+            } else if (args[k] == "--max-frame-size" && k + 1 < args.size()) {
+                options.max_frame_size = std::stoul(args[++k]);
+            } else if (args[k] == "--help") {
+                std::cout << USAGE;
+                return 0;
+            } else {
+                throw std::invalid_argument(args[k]);
+            }
+        }
+    } catch (std::logic_error& e) {
+        std::cerr << "Bad argument: " << e.what() << "\n\n" << USAGE;
+        return 2;
+    }
+
+    try {
+        Server server(options);
+
+        running_server = &server;
+        struct sigaction action = {};
+        action.sa_handler = handleSignal;
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+
+        std::cerr << "genomus-server listening on " << options.socket_path << std::endl;
+        server.run();
+        running_server = nullptr;
+    } catch (std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
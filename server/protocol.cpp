@@ -0,0 +1,164 @@
+#include "protocol.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../library/errorCodes.hpp"
+
+// PayloadWriter
+
+Protocol::PayloadWriter& Protocol::PayloadWriter::header(FrameType type, uint64_t request_id, uint32_t length) {
+    FrameHeader header = {
+        .magic = MAGIC,
+        .length = length,
+        .request_id = request_id,
+        .type = type,
+        .reserved = {},
+    };
+    this -> _bytes.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    return *this;
+}
+
+Protocol::PayloadWriter& Protocol::PayloadWriter::u32(uint32_t value) {
+    this -> _bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return *this;
+}
+
+Protocol::PayloadWriter& Protocol::PayloadWriter::u64(uint64_t value) {
+    this -> _bytes.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    return *this;
+}
+
+Protocol::PayloadWriter& Protocol::PayloadWriter::doubles(std::span<const double> values) {
+    this -> _bytes.append(reinterpret_cast<const char*>(values.data()), values.size_bytes());
+    return *this;
+}
+
+Protocol::PayloadWriter& Protocol::PayloadWriter::bytes(std::string_view bytes) {
+    this -> _bytes.append(bytes);
+    return *this;
+}
+
+std::string& Protocol::PayloadWriter::str() { return this -> _bytes; }
+
+// PayloadReader
+
+Protocol::PayloadReader::PayloadReader(std::string_view bytes) : _bytes(bytes), _position(0) {}
+
+void Protocol::PayloadReader::_require(size_t count) const {
+    if (this -> remaining() < count) {
+        throw std::runtime_error(ErrorCodes::BAD_SERVER_REQUEST + ": truncated payload");
+    }
+}
+
+uint32_t Protocol::PayloadReader::u32() {
+    uint32_t value;
+    this -> _require(sizeof(value));
+    std::memcpy(&value, this -> _bytes.data() + this -> _position, sizeof(value));
+    this -> _position += sizeof(value);
+    return value;
+}
+
+uint64_t Protocol::PayloadReader::u64() {
+    uint64_t value;
+    this -> _require(sizeof(value));
+    std::memcpy(&value, this -> _bytes.data() + this -> _position, sizeof(value));
+    this -> _position += sizeof(value);
+    return value;
+}
+
+Protocol::FrameHeader Protocol::PayloadReader::header() {
+    FrameHeader header;
+    this -> _require(sizeof(header));
+    std::memcpy(&header, this -> _bytes.data() + this -> _position, sizeof(header));
+    this -> _position += sizeof(header);
+
+    if (header.magic != MAGIC) {
+        throw std::runtime_error(ErrorCodes::BAD_SERVER_REQUEST + ": bad frame magic");
+    }
+    return header;
+}
+
+std::vector<double> Protocol::PayloadReader::doubles(size_t count) {
+    // Counts come from the client: checked before allocating, without multiplying them
+    if (count > this -> remaining() / sizeof(double)) {
+        throw std::runtime_error(ErrorCodes::BAD_SERVER_REQUEST + ": truncated payload");
+    }
+    std::vector<double> values(count);
+    if (count) std::memcpy(values.data(), this -> _bytes.data() + this -> _position, count * sizeof(double));
+    this -> _position += count * sizeof(double);
+    return values;
+}
+
+std::string_view Protocol::PayloadReader::bytes(size_t count) {
+    this -> _require(count);
+    const auto bytes = this -> _bytes.substr(this -> _position, count);
+    this -> _position += count;
+    return bytes;
+}
+
+std::string_view Protocol::PayloadReader::rest() { return this -> bytes(this -> remaining()); }
+size_t Protocol::PayloadReader::remaining() const { return this -> _bytes.size() - this -> _position; }
+
+std::string Protocol::encodeFrame(FrameType type, uint64_t request_id, std::string_view payload) {
+    PayloadWriter writer;
+    writer.header(type, request_id, payload.size()).bytes(payload);
+    return std::move(writer.str());
+}
+
+// Blocking client helpers
+
+int Protocol::connectTo(const std::string& socket_path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error(ErrorCodes::SERVER_SOCKET_NOT_ACCESSIBLE + ": socket path too long");
+    }
+    std::memcpy(address.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        if (fd >= 0) close(fd);
+        throw std::runtime_error(ErrorCodes::SERVER_SOCKET_NOT_ACCESSIBLE + ": " + socket_path + ": " + std::strerror(errno));
+    }
+    return fd;
+}
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size) {
+        const ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* data, size_t size) {
+    while (size) {
+        const ssize_t read = recv(fd, data, size, 0);
+        if (read < 0 && errno == EINTR) continue;
+        if (read <= 0) return false;
+        data += read;
+        size -= read;
+    }
+    return true;
+}
+
+bool Protocol::writeFrame(int fd, FrameType type, uint64_t request_id, std::string_view payload) {
+    const std::string frame = encodeFrame(type, request_id, payload);
+    return writeAll(fd, frame.data(), frame.size());
+}
+
+bool Protocol::readFrame(int fd, FrameHeader& header, std::string& payload) {
+    if (!readAll(fd, reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != MAGIC) {
+        return false;
+    }
+    payload.resize(header.length);
+    return readAll(fd, payload.data(), payload.size());
+}
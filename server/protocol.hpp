@@ -0,0 +1,93 @@
+#ifndef __GENOMUS_SERVER_PROTOCOL__
+#define __GENOMUS_SERVER_PROTOCOL__
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+    genomus-server protocol. Every message, in both directions, is a frame: a 24 byte FrameHeader followed by
+    `length` bytes of payload. Integers and doubles are sent in host byte order, as the socket is local.
+
+    Requests and their payloads:
+        evaluate_expression     u64 seed, expression text (rest of the payload)
+        evaluate_germinal       u64 seed, germinal vector doubles (rest of the payload)
+        batch                   u32 count, followed by count complete request frames
+        stats                   empty
+
+    Responses echo the request id. Requests are evaluated concurrently, so responses to pipelined requests
+    may arrive in any order:
+        result                  u32 n, n doubles of encoded genotype, u32 m, m doubles of phenotype normalized vector,
+                                decoded genotype expression (rest of the payload)
+        batch_result            u32 count, followed by the count response frames, in request order
+        stats_result            JSON object with the server counters
+        error                   error message
+*/
+
+namespace Protocol {
+    // "GNMS"
+    constexpr uint32_t MAGIC = 0x534d4e47;
+
+    enum FrameType : uint8_t {
+        evaluate_expression = 0x01,
+        evaluate_germinal = 0x02,
+        batch = 0x03,
+        stats = 0x04,
+
+        result = 0x81,
+        batch_result = 0x83,
+        stats_result = 0x84,
+        error = 0xff,
+    };
+
+    struct FrameHeader {
+        uint32_t magic;
+        uint32_t length;
+        uint64_t request_id;
+        uint8_t type;
+        uint8_t reserved[7];
+    };
+
+    static_assert(sizeof(FrameHeader) == 24);
+
+    // Builds a payload, or a whole frame when starting with header()
+    class PayloadWriter {
+        private:
+            std::string _bytes;
+        public:
+            PayloadWriter& header(FrameType, uint64_t request_id, uint32_t length);
+            PayloadWriter& u32(uint32_t);
+            PayloadWriter& u64(uint64_t);
+            PayloadWriter& doubles(std::span<const double>);
+            PayloadWriter& bytes(std::string_view);
+            std::string& str();
+    };
+
+    // Reads a payload. Reading past its end throws
+    class PayloadReader {
+        private:
+            std::string_view _bytes;
+            size_t _position;
+            void _require(size_t) const;
+        public:
+            PayloadReader(std::string_view);
+            uint32_t u32();
+            uint64_t u64();
+            FrameHeader header();
+            std::vector<double> doubles(size_t count);
+            std::string_view bytes(size_t count);
+            std::string_view rest();
+            size_t remaining() const;
+    };
+
+    std::string encodeFrame(FrameType, uint64_t request_id, std::string_view payload);
+
+    // Blocking helpers for clients. Both return false when the connection is closed or fails
+    int connectTo(const std::string& socket_path);
+    bool writeFrame(int fd, FrameType, uint64_t request_id, std::string_view payload);
+    bool readFrame(int fd, FrameHeader&, std::string& payload);
+}
+
+#endif
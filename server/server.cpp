@@ -0,0 +1,524 @@
+#include "server.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <iomanip>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../library/errorCodes.hpp"
+#include "../library/genomus-core.hpp"
+
+using namespace Protocol;
+
+struct Server::Connection {
+    const int fd;
+    // Only used by the thread running the server loop
+    std::string input;
+    // Cleared once the input is closed. The connection is kept until its responses are sent
+    std::atomic<bool> reading = true;
+    // Jobs queued for the connection whose responses are not written yet
+    std::atomic<size_t> jobs = 0;
+
+    std::mutex write_mutex;
+    // Bytes the socket did not take yet, sent by the server loop once the socket is writable
+    std::string output;
+    bool broken = false;
+
+    Connection(int fd) : fd(fd) {}
+    ~Connection() { close(this -> fd); }
+
+    // Responses of a connection are written by any worker, one at a time, and never block.
+    // Returns true when output starts waiting for the socket, which the server loop must learn about.
+    bool write(std::string_view frame) {
+        std::lock_guard<std::mutex> lock(this -> write_mutex);
+        if (this -> broken) return false;
+
+        const bool waiting = !this -> output.empty();
+        this -> output.append(frame);
+        if (waiting) return false;
+
+        this -> _send();
+        return !this -> output.empty();
+    }
+
+    // Sends what the socket takes. Returns the bytes left waiting
+    size_t flush() {
+        std::lock_guard<std::mutex> lock(this -> write_mutex);
+        this -> _send();
+        return this -> output.size();
+    }
+
+    size_t waiting() {
+        std::lock_guard<std::mutex> lock(this -> write_mutex);
+        return this -> output.size();
+    }
+
+    private:
+        void _send() {
+            size_t sent = 0;
+            while (sent < this -> output.size()) {
+                const ssize_t written = send(this -> fd, this -> output.data() + sent, this -> output.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (written < 0 && errno == EINTR) continue;
+                if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                if (written <= 0) {
+                    this -> broken = true;
+                    this -> output.clear();
+                    return;
+                }
+                sent += written;
+            }
+            this -> output.erase(0, sent);
+        }
+};
+
+struct Server::Batch {
+    uint64_t request_id;
+    std::vector<std::string> responses;
+    std::atomic<size_t> remaining;
+    server_clock::time_point received;
+};
+
+struct Server::Job {
+    std::shared_ptr<Connection> connection;
+    FrameType type;
+    uint64_t request_id;
+    std::string payload;
+    server_clock::time_point received;
+    // Set for the requests of a batch frame
+    std::shared_ptr<Batch> batch;
+    size_t batch_index;
+};
+
+Server::Server(ServerOptions options) : _options(options), _listen_fd(-1), _stop_pipe{-1, -1}, _wake_pipe{-1, -1}, _stopping(false) {
+    if (!this -> _options.threads) {
+        this -> _options.threads = std::max<unsigned int>(1, std::thread::hardware_concurrency());
+    }
+
+    for (auto& bucket : this -> _latency_histogram) bucket = 0;
+    this -> _connections_total = this -> _connections_open = this -> _requests = 0;
+    this -> _errors = this -> _in_flight = this -> _latency_total_us = 0;
+
+    init_available_functions();
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    const std::string& path = this -> _options.socket_path;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error(ErrorCodes::SERVER_SOCKET_NOT_ACCESSIBLE + ": bad socket path " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    // A socket left by a server that is not running anymore is replaced. Any other file is left untouched
+    struct stat existing;
+    if (stat(path.c_str(), &existing) == 0 && S_ISSOCK(existing.st_mode)) {
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const bool listening = fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if (fd >= 0) close(fd);
+
+        if (listening) {
+            throw std::runtime_error(ErrorCodes::SERVER_SOCKET_NOT_ACCESSIBLE + ": a server is already listening on " + path);
+        }
+        unlink(path.c_str());
+    }
+
+    this -> _listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (this -> _listen_fd < 0
+        || bind(this -> _listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || listen(this -> _listen_fd, SOMAXCONN) < 0
+        || pipe2(this -> _stop_pipe, O_CLOEXEC | O_NONBLOCK) < 0
+        || pipe2(this -> _wake_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        const std::string reason = std::strerror(errno);
+        if (this -> _listen_fd >= 0) close(this -> _listen_fd);
+        for (int fd : this -> _stop_pipe) if (fd >= 0) close(fd);
+        throw std::runtime_error(ErrorCodes::SERVER_SOCKET_NOT_ACCESSIBLE + ": " + path + ": " + reason);
+    }
+
+    this -> _started = server_clock::now();
+}
+
+Server::~Server() {
+    close(this -> _listen_fd);
+    close(this -> _stop_pipe[0]);
+    close(this -> _stop_pipe[1]);
+    close(this -> _wake_pipe[0]);
+    close(this -> _wake_pipe[1]);
+    unlink(this -> _options.socket_path.c_str());
+}
+
+void Server::stop() {
+    const char byte = 0;
+    [[maybe_unused]] auto written = write(this -> _stop_pipe[1], &byte, 1);
+}
+
+void Server::_wake() {
+    const char byte = 0;
+    [[maybe_unused]] auto written = write(this -> _wake_pipe[1], &byte, 1);
+}
+
+void Server::_write(Connection& connection, std::string_view frame) {
+    if (connection.write(frame)) this -> _wake();
+}
+
+void Server::run() {
+    this -> _stopping = false;
+    for (size_t k = 0; k < this -> _options.threads; ++k) {
+        this -> _workers.emplace_back([this]() { this -> _work(); });
+    }
+
+    std::vector<std::shared_ptr<Connection>> connections;
+    std::vector<pollfd> fds;
+
+    while (true) {
+        fds.clear();
+        fds.push_back({ .fd = this -> _stop_pipe[0], .events = POLLIN, .revents = 0 });
+        fds.push_back({ .fd = this -> _wake_pipe[0], .events = POLLIN, .revents = 0 });
+        fds.push_back({ .fd = this -> _listen_fd, .events = POLLIN, .revents = 0 });
+        for (auto& connection : connections) {
+            const size_t waiting = connection -> waiting();
+            short events = 0;
+            // Connections with a whole frame of output waiting are not read until it is sent
+            if (connection -> reading && waiting < this -> _options.max_frame_size) events |= POLLIN;
+            if (waiting) events |= POLLOUT;
+            // Closed connections with nothing to send wait for their jobs, which wake the loop
+            fds.push_back({ .fd = events ? connection -> fd : -1, .events = events, .revents = 0 });
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (fds[0].revents) break;
+
+        if (fds[1].revents) {
+            char buffer[64];
+            while (read(this -> _wake_pipe[0], buffer, sizeof(buffer)) > 0);
+        }
+
+        // Connections accepted now are polled from the next iteration on
+        const size_t polled = connections.size();
+
+        if (fds[2].revents & POLLIN) {
+            // Sockets never block the loop: input is read while available and output waits for POLLOUT
+            const int fd = accept4(this -> _listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+            if (fd >= 0) {
+                connections.push_back(std::make_shared<Connection>(fd));
+                this -> _connections_total++;
+                this -> _connections_open++;
+            }
+        }
+
+        for (size_t k = polled; k-- > 0;) {
+            Connection& connection = *connections[k];
+            const short revents = fds[k + 3].revents;
+
+            if (revents & POLLOUT) connection.flush();
+            if (connection.reading && (revents & (POLLIN | POLLHUP | POLLERR)) && !this -> _readFrames(connection, connections[k])) {
+                connection.reading = false;
+                this -> _connections_open--;
+            }
+
+            // Pending jobs keep the connection, and its descriptor, alive until their responses are written
+            if (!connection.reading && !connection.jobs && !connection.waiting()) {
+                connections.erase(connections.begin() + k);
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(this -> _queue_mutex);
+        this -> _stopping = true;
+    }
+    this -> _queue_condition.notify_all();
+    for (auto& worker : this -> _workers) worker.join();
+    this -> _workers.clear();
+    this -> _queue.clear();
+    for (auto& connection : connections) if (connection -> reading) this -> _connections_open--;
+
+    // Drains the stop requests
+    char buffer[64];
+    while (read(this -> _stop_pipe[0], buffer, sizeof(buffer)) > 0);
+}
+
+// Reads what is available and queues every complete frame. Returns false once the connection is to be closed.
+// Frames are split after every read, so a frame header announcing too much stops the reading at once.
+bool Server::_readFrames(Connection& connection, const std::shared_ptr<Connection>& shared_connection) {
+    char buffer[1 << 16];
+
+    while (true) {
+        const ssize_t read = recv(connection.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (read < 0 && errno == EINTR) continue;
+        if (read <= 0) return read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+
+        connection.input.append(buffer, read);
+        if (!this -> _splitFrames(connection, shared_connection)) return false;
+    }
+}
+
+// Queues the complete frames of the input. Returns false on a bad frame header
+bool Server::_splitFrames(Connection& connection, const std::shared_ptr<Connection>& shared_connection) {
+    size_t consumed = 0;
+    while (connection.input.size() - consumed >= sizeof(FrameHeader)) {
+        FrameHeader header;
+        std::memcpy(&header, connection.input.data() + consumed, sizeof(header));
+
+        if (header.magic != MAGIC || header.length > this -> _options.max_frame_size) {
+            this -> _errors++;
+            this -> _write(connection, encodeFrame(error, header.request_id, ErrorCodes::BAD_SERVER_REQUEST + ": bad frame header"));
+            return false;
+        }
+
+        if (connection.input.size() - consumed < sizeof(header) + header.length) break;
+
+        const std::string_view payload(connection.input.data() + consumed + sizeof(header), header.length);
+        this -> _enqueue(shared_connection, header, payload);
+        consumed += sizeof(header) + header.length;
+    }
+    connection.input.erase(0, consumed);
+
+    return true;
+}
+
+void Server::_enqueue(std::shared_ptr<Connection> connection, const FrameHeader& header, std::string_view payload) {
+    const auto received = server_clock::now();
+    const FrameType type = static_cast<FrameType>(header.type);
+
+    // Stats are answered at once, and do not count themselves in flight. Every response is recorded before
+    // it is written, so a client never reads stats missing a response it holds
+    if (type == stats) {
+        this -> _requests++;
+        const std::string response = encodeFrame(stats_result, header.request_id, this -> statsToJSON());
+        this -> _recordLatency(received);
+        this -> _write(*connection, response);
+        return;
+    }
+
+    this -> _in_flight++;
+
+    std::vector<Job> jobs;
+
+    if (type == batch) {
+        auto shared_batch = std::make_shared<Batch>();
+        shared_batch -> request_id = header.request_id;
+        shared_batch -> received = received;
+
+        try {
+            PayloadReader reader(payload);
+            const uint32_t count = reader.u32();
+            // Every request takes a header at least, so larger counts cannot be in the payload
+            if (count > reader.remaining() / sizeof(FrameHeader)) {
+                throw std::runtime_error(ErrorCodes::BAD_SERVER_REQUEST + ": batch count exceeds its payload");
+            }
+            shared_batch -> responses.resize(count);
+            shared_batch -> remaining = count;
+
+            for (uint32_t k = 0; k < count; ++k) {
+                const FrameHeader item = reader.header();
+                jobs.push_back({
+                    .connection = connection,
+                    .type = static_cast<FrameType>(item.type),
+                    .request_id = item.request_id,
+                    .payload = std::string(reader.bytes(item.length)),
+                    .received = received,
+                    .batch = shared_batch,
+                    .batch_index = k,
+                });
+            }
+        } catch (std::exception& e) {
+            this -> _errors++;
+            this -> _recordLatency(received);
+            this -> _in_flight--;
+            this -> _write(*connection, encodeFrame(error, header.request_id, e.what()));
+            return;
+        }
+
+        if (jobs.empty()) {
+            this -> _recordLatency(received);
+            this -> _in_flight--;
+            this -> _write(*connection, PayloadWriter().header(batch_result, header.request_id, sizeof(uint32_t)).u32(0).str());
+            return;
+        }
+    } else {
+        jobs.push_back({
+            .connection = connection,
+            .type = type,
+            .request_id = header.request_id,
+            .payload = std::string(payload),
+            .received = received,
+            .batch = nullptr,
+            .batch_index = 0,
+        });
+    }
+
+    connection -> jobs += jobs.size();
+    {
+        std::lock_guard<std::mutex> lock(this -> _queue_mutex);
+        for (auto& job : jobs) this -> _queue.push_back(std::move(job));
+    }
+    this -> _queue_condition.notify_all();
+}
+
+void Server::_work() {
+    // Every worker builds and evaluates trees in a context of its own
+    GTree::Context context;
+    GTree::Context::Scope scope(context);
+
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(this -> _queue_mutex);
+            this -> _queue_condition.wait(lock, [this]() { return this -> _stopping || !this -> _queue.empty(); });
+            if (this -> _stopping) return;
+            job = std::move(this -> _queue.front());
+            this -> _queue.pop_front();
+        }
+
+        std::string response = this -> _evaluate(job.type, job.request_id, job.payload);
+        // Responses are self-contained: no tree outlives its job, so the worker context is emptied after each one
+        GTree::clean();
+        this -> _complete(job, std::move(response));
+
+        // Closed connections are released by the server loop once their last job is done
+        if (--job.connection -> jobs == 0 && !job.connection -> reading) this -> _wake();
+    }
+}
+
+std::string Server::_evaluate(FrameType type, uint64_t request_id, std::string_view payload) {
+    this -> _requests++;
+
+    try {
+        if (type == stats) {
+            return encodeFrame(stats_result, request_id, this -> statsToJSON());
+        }
+
+        if (type != evaluate_expression && type != evaluate_germinal) {
+            throw std::runtime_error(ErrorCodes::BAD_SERVER_REQUEST + ": unknown request type " + std::to_string(type));
+        }
+
+        PayloadReader reader(payload);
+        const uint64_t seed = reader.u64();
+
+        GTree::clean();
+        GTree::RNG.seed(seed);
+
+        dec_gen_t tree = 0;
+        enc_gen_t encoded_genotype;
+
+        // Malformed genotypes are answered without unwinding, see GenomusError
+        const auto reject = [&](const GenomusError& failure) {
+            this -> _errors++;
+            return encodeFrame(error, request_id, errorToString(failure));
+        };
+
+        if (type == evaluate_expression) {
+            Result<dec_gen_t> parsed = tryParseString(reader.rest());
+            if (!parsed) return reject(parsed.error());
+            tree = *parsed;
+            encoded_genotype = tree.toNormalizedVector();
+        } else {
+            if (reader.remaining() % sizeof(double)) {
+                throw std::runtime_error(ErrorCodes::BAD_SERVER_REQUEST + ": germinal vector size is not a multiple of 8 bytes");
+            }
+            const auto germinal_vector = reader.doubles(reader.remaining() / sizeof(double));
+            const Result<size_t> normalized = tryNormalizeVector(germinal_vector, encoded_genotype);
+            if (!normalized) return reject(normalized.error());
+            tree = parseString(toExpression(encoded_genotype));
+        }
+
+        const Result<enc_phen_t> evaluated = tree.tryEvaluate(GTree::phenotype_arena);
+        if (!evaluated) return reject(evaluated.error());
+        const auto phenotype = evaluated -> toNormalizedVector();
+        const std::string expression = tree.toString();
+
+        const size_t length = 2 * sizeof(uint32_t) + (encoded_genotype.size() + phenotype.size()) * sizeof(double) + expression.size();
+        PayloadWriter writer;
+        writer.header(result, request_id, length)
+            .u32(encoded_genotype.size()).doubles(encoded_genotype)
+            .u32(phenotype.size()).doubles(phenotype)
+            .bytes(expression);
+        return std::move(writer.str());
+    } catch (std::exception& e) {
+        this -> _errors++;
+        return encodeFrame(error, request_id, e.what());
+    }
+}
+
+void Server::_complete(Job& job, std::string response) {
+    if (job.batch) {
+        Batch& batch = *job.batch;
+        batch.responses[job.batch_index] = std::move(response);
+        // The last request of the batch writes every response
+        if (batch.remaining.fetch_sub(1) != 1) return;
+
+        size_t length = sizeof(uint32_t);
+        for (auto& item : batch.responses) length += item.size();
+
+        PayloadWriter writer;
+        writer.header(batch_result, batch.request_id, length).u32(batch.responses.size());
+        for (auto& item : batch.responses) writer.bytes(item);
+        response = std::move(writer.str());
+    }
+
+    this -> _recordLatency(job.received);
+    this -> _in_flight--;
+    this -> _write(*job.connection, response);
+}
+
+void Server::_recordLatency(server_clock::time_point received) {
+    const uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(server_clock::now() - received).count();
+    this -> _latency_total_us += us;
+    this -> _latency_histogram[std::min<size_t>(std::bit_width(us), SERVER_LATENCY_BUCKETS - 1)]++;
+}
+
+std::string Server::statsToJSON() const {
+    const double uptime = std::chrono::duration<double>(server_clock::now() - this -> _started).count();
+
+    std::array<uint64_t, SERVER_LATENCY_BUCKETS> histogram;
+    uint64_t responses = 0;
+    for (size_t k = 0; k < SERVER_LATENCY_BUCKETS; ++k) {
+        histogram[k] = this -> _latency_histogram[k];
+        responses += histogram[k];
+    }
+
+    // Upper bound of the histogram bucket holding the percentile
+    const auto percentile = [&](double p) -> uint64_t {
+        const uint64_t rank = std::max<uint64_t>(1, std::ceil(p / 100 * responses));
+        uint64_t seen = 0;
+        for (size_t k = 0; k < SERVER_LATENCY_BUCKETS; ++k) {
+            seen += histogram[k];
+            if (seen >= rank) return uint64_t(1) << k;
+        }
+        return 0;
+    };
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3)
+       << "{\"uptime_s\": " << uptime
+       << ", \"threads\": " << this -> _options.threads
+       << ", \"connections_total\": " << this -> _connections_total
+       << ", \"connections_open\": " << this -> _connections_open
+       << ", \"requests\": " << this -> _requests
+       << ", \"errors\": " << this -> _errors
+       << ", \"in_flight\": " << this -> _in_flight
+       << ", \"requests_per_second\": " << (uptime > 0 ? this -> _requests / uptime : 0)
+       << ", \"latency_us\": {\"responses\": " << responses
+       << ", \"mean\": " << (responses ? (double) this -> _latency_total_us / responses : 0);
+
+    if (responses) {
+        ss << ", \"p50\": " << percentile(50) << ", \"p90\": " << percentile(90)
+           << ", \"p99\": " << percentile(99) << ", \"max\": " << percentile(100);
+    }
+    ss << "}}";
+
+    return ss.str();
+}
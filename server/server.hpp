@@ -0,0 +1,97 @@
+#ifndef __GENOMUS_SERVER__
+#define __GENOMUS_SERVER__
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "protocol.hpp"
+
+#define SERVER_DEFAULT_MAX_FRAME_SIZE (64 << 20)
+#define SERVER_LATENCY_BUCKETS 40
+
+struct ServerOptions {
+    std::string socket_path;
+    // 0 uses every hardware thread
+    size_t threads = 0;
+    // Connections sending larger frames are closed
+    size_t max_frame_size = SERVER_DEFAULT_MAX_FRAME_SIZE;
+};
+
+/*
+    Server evaluates genomus requests sent over a UNIX domain socket, see protocol.hpp. The function library
+    is initialized once, when the server is built.
+
+    The thread calling run() multiplexes every connection with poll(), splits their input in frames and
+    queues one job per request, so clients may pipeline any number of requests. A pool of workers, each one
+    with a GTree::Context of its own, evaluates the jobs and writes the responses. Sockets never block:
+    responses the socket does not take at once wait in the connection, and are sent by the server loop
+    when the socket is writable. Connections with a whole frame of responses waiting are not read until
+    they are sent, so clients that do not read their responses cannot make the server hold more. Requests in a batch frame
+    are queued as separate jobs and answered together once the last one is done. Stats requests are
+    answered right away, without going through the queue.
+
+    Latencies go from the moment a request frame is read to the moment its response is written.
+*/
+class Server {
+    private:
+        struct Connection;
+        struct Batch;
+        struct Job;
+
+        using server_clock = std::chrono::steady_clock;
+
+        ServerOptions _options;
+        int _listen_fd;
+        int _stop_pipe[2];
+        // Written by workers when the server loop has new output to poll for
+        int _wake_pipe[2];
+        server_clock::time_point _started;
+
+        std::mutex _queue_mutex;
+        std::condition_variable _queue_condition;
+        std::deque<Job> _queue;
+        bool _stopping;
+        std::vector<std::thread> _workers;
+
+        std::atomic<uint64_t> _connections_total;
+        std::atomic<uint64_t> _connections_open;
+        std::atomic<uint64_t> _requests;
+        std::atomic<uint64_t> _errors;
+        std::atomic<uint64_t> _in_flight;
+        std::atomic<uint64_t> _latency_total_us;
+        // Bucket i counts responses that took [2^(i-1), 2^i) microseconds
+        std::array<std::atomic<uint64_t>, SERVER_LATENCY_BUCKETS> _latency_histogram;
+
+        void _work();
+        void _wake();
+        // Writes without blocking, waking the server loop when part of the frame has to wait for the socket
+        void _write(Connection&, std::string_view frame);
+        void _enqueue(std::shared_ptr<Connection>, const Protocol::FrameHeader&, std::string_view payload);
+        bool _readFrames(Connection&, const std::shared_ptr<Connection>&);
+        bool _splitFrames(Connection&, const std::shared_ptr<Connection>&);
+        std::string _evaluate(Protocol::FrameType, uint64_t request_id, std::string_view payload);
+        void _complete(Job&, std::string response);
+        void _recordLatency(server_clock::time_point received);
+    public:
+        Server(ServerOptions);
+        ~Server();
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        // Serves until stop() is called
+        void run();
+        // Safe to call from a signal handler
+        void stop();
+
+        std::string statsToJSON() const;
+};
+
+#endif
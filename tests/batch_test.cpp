@@ -0,0 +1,119 @@
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+static const string expression = "s(v(e_piano(n(0.1), m(0.2), a(0.3), i(0.4))))";
+
+static vector<string> outputLines(const vector<string>& expressions, size_t threads, size_t& failed) {
+    stringstream output;
+    failed = runBatch(expressions, output, { .threads = threads });
+
+    vector<string> lines;
+    string line;
+    while (getline(output, line)) lines.push_back(line);
+    return lines;
+}
+
+// Lines without their timings, which vary between runs
+static string withoutTimings(const string& line) {
+    return line.substr(0, line.find(", \"timings_ms\""));
+}
+
+GTest BatchTest = GTest("Batch Test")
+
+    .before([]() { init_genomus(); })
+
+    .testCase("Read expressions", [](ostream& os) {
+        stringstream input("s(v(e_piano(n(0.1), m(0.2),\n a(0.3), i(0.4))));\n\n ;s(v(x(0.1)));  trailing");
+        const vector<string> expressions = readExpressions(input);
+
+        if (expressions.size() != 3 || expressions[0].find('\n') == string::npos || expressions[1] != "s(v(x(0.1)))" || expressions[2] != "trailing") {
+            throw runtime_error("Expected expressions split at semicolons, spanning lines and without blanks.");
+        }
+    })
+
+    .testCase("Results in input order", [](ostream& os) {
+        vector<string> expressions;
+        for (size_t k = 0; k < 40; ++k) {
+            expressions.push_back("s(v(e_piano(n(0." + to_string(k % 9 + 1) + "), m(0.2), a(0.3), i(0.4))))");
+        }
+
+        size_t failed;
+        const vector<string> lines = outputLines(expressions, 4, failed);
+        if (failed || lines.size() != expressions.size()) {
+            throw runtime_error("Expected a line for every expression, without failures.");
+        }
+
+        for (size_t k = 0; k < lines.size(); ++k) {
+            if (lines[k].rfind("{\"index\": " + to_string(k) + ", \"expression\": \"" + expressions[k] + "\"", 0) != 0) {
+                throw runtime_error("Expected line " + to_string(k) + " to hold its expression: " + lines[k]);
+            }
+            if (lines[k].find("\"encode_genotype\"") == string::npos || lines[k].find("\"encode_phenotype\"") == string::npos) {
+                throw runtime_error("Expected every stage to be timed: " + lines[k]);
+            }
+        }
+    })
+
+    .testCase("Thread counts", [](ostream& os) {
+        const vector<string> expressions = { expression, "s(v(x(0.1)))", expression, "", "s(" };
+        size_t failed;
+        const vector<string> sequential = outputLines(expressions, 1, failed);
+
+        // More threads than expressions included, and 0 for every hardware thread
+        for (size_t threads : { 0, 2, 8 }) {
+            size_t parallel_failed;
+            const vector<string> parallel = outputLines(expressions, threads, parallel_failed);
+
+            if (parallel.size() != sequential.size() || parallel_failed != failed) {
+                throw runtime_error("Expected the same lines with " + to_string(threads) + " threads.");
+            }
+            for (size_t k = 0; k < parallel.size(); ++k) {
+                if (withoutTimings(parallel[k]) != withoutTimings(sequential[k])) {
+                    throw runtime_error("Expected the same results with " + to_string(threads) + " threads: " + parallel[k]);
+                }
+            }
+        }
+    })
+
+    .testCase("Error records", [](ostream& os) {
+        const vector<string> expressions = { "s(v(x(0.1)))", expression, "s(", "s(v(e_piano(n(0.1))))" };
+        size_t failed;
+        const vector<string> lines = outputLines(expressions, 2, failed);
+
+        if (failed != 3 || lines.size() != expressions.size()) {
+            throw runtime_error("Expected three failed expressions, reported in their lines.");
+        }
+
+        for (size_t k : { 0, 2, 3 }) {
+            os << lines[k] << endl;
+            if (lines[k].find("\"error\": \"BAD_") == string::npos || lines[k].find("\"phenotype\"") != string::npos) {
+                throw runtime_error("Expected an error record instead of results: " + lines[k]);
+            }
+        }
+        if (lines[1].find("\"error\"") != string::npos) {
+            throw runtime_error("Expected the valid expression to be evaluated despite the others: " + lines[1]);
+        }
+    })
+
+    .testCase("JSON numbers", [](ostream& os) {
+        stringstream ss;
+        for (double value : { 0.1, -2.0, numeric_limits<double>::quiet_NaN(), numeric_limits<double>::infinity(), -numeric_limits<double>::infinity() }) {
+            writeJSONNumber(ss, value);
+            ss << ' ';
+        }
+
+        if (ss.str() != "0.1 -2 null null null ") {
+            throw runtime_error("Expected non-finite numbers to be written as null: " + ss.str());
+        }
+    });
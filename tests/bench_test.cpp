@@ -0,0 +1,73 @@
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bench.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+static const string expression = "s(v(e_piano(n(0.1), m(0.2), a(0.3), i(0.4))))";
+
+static bool rejects(const string& arguments, const string& message) {
+    try {
+        parseBenchArguments(arguments);
+    } catch (runtime_error& e) {
+        return string(e.what()).find(message) == 0;
+    }
+    return false;
+}
+
+GTest BenchTest = GTest("Bench Test")
+
+    .testCase("Bench arguments", [](ostream& os) {
+        if (parseBenchArguments(expression) != make_pair(expression, size_t(BENCH_DEFAULT_ITERATIONS))) {
+            throw runtime_error("Expected the default iteration count without a trailing count.");
+        }
+
+        if (parseBenchArguments(expression + " 250") != make_pair(expression, size_t(250))
+            || parseBenchArguments(expression + " \n\t7") != make_pair(expression, size_t(7))) {
+            throw runtime_error("Expected a trailing count to be split from the expression.");
+        }
+
+        // Trailing words that are not counts belong to the expression
+        for (const string arguments : { expression + " 12a", expression + " -3", expression + " 1.5", string("250") }) {
+            if (parseBenchArguments(arguments) != make_pair(arguments, size_t(BENCH_DEFAULT_ITERATIONS))) {
+                throw runtime_error("Expected no count in: " + arguments);
+            }
+        }
+
+        if (parseBenchArguments(expression + " 18446744073709551615").second != 18446744073709551615ull) {
+            throw runtime_error("Expected the largest count to be parsed.");
+        }
+        if (!rejects(expression + " 18446744073709551616", "Too many iterations")
+            || !rejects(expression + " 99999999999999999999999999", "Too many iterations")) {
+            throw runtime_error("Expected out of range counts to be rejected.");
+        }
+        if (!rejects(expression + " 0", "Expected a positive number of iterations")
+            || !rejects(expression + " 000", "Expected a positive number of iterations")) {
+            throw runtime_error("Expected zero iterations to be rejected.");
+        }
+    })
+
+    .testCase("Percentiles", [](ostream& os) {
+        const vector<double> one = { 4.0 };
+        for (double p : { 0.0, 50.0, 99.0, 100.0 }) {
+            if (percentile(one, p) != 4.0) throw runtime_error("Expected every percentile of one value to be the value.");
+        }
+
+        vector<double> hundred;
+        for (size_t k = 1; k <= 100; ++k) hundred.push_back(k);
+        if (percentile(hundred, 50) != 50 || percentile(hundred, 90) != 90 || percentile(hundred, 99) != 99
+            || percentile(hundred, 100) != 100 || percentile(hundred, 0) != 1) {
+            throw runtime_error("Expected the nearest rank of a hundred values to be the percentile.");
+        }
+
+        // Ranks round up: the 50th percentile of 1, 2, 3 is 2 and the 99th is 3
+        const vector<double> three = { 1.0, 2.0, 3.0 };
+        if (percentile(three, 50) != 2.0 || percentile(three, 99) != 3.0 || percentile(three, 10) != 1.0) {
+            throw runtime_error("Expected nearest rank percentiles of three values.");
+        }
+    });
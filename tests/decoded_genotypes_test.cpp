@@ -1,9 +1,11 @@
 #include <algorithm>
+#include <functional>
 #include <iostream>
 #include <ostream>
 #include <stdexcept>
 
 #include "decoded_genotype.hpp"
+#include "errorCodes.hpp"
 #include "genomus-core.hpp"
 #include "testing_utils.hpp"
 
@@ -54,6 +56,25 @@ GTest DecodedGenotypesTest = GTest("Decoded GenotypesTest")
         dec_gen_t::clean();
     })
 
+    .testCase("Score concatenation", [](ostream& os) {
+        dec_gen_t first = v({e_piano({n(1.0), m(1.0), a(1.0), i(1)})});
+        dec_gen_t second = v({e_piano({n(2.0), m(2.0), a(2.0), i(2)})});
+        dec_gen_t third = v({e_piano({n(3.0), m(3.0), a(3.0), i(3)})});
+
+        auto added = sAddV({s({first}), second}).evaluate().toString();
+        auto expected_added = s2V({first, second}).evaluate().toString();
+        if (added != expected_added) {
+            throw runtime_error("Expected sAddV to append the voice: " + added);
+        }
+
+        auto joined = sAddS({s2V({first, second}), s({third})}).evaluate();
+        if (joined.getChildren().size() != 3 || joined.toString().find("e(") == std::string::npos) {
+            throw runtime_error("Expected sAddS to keep the voices of both scores.");
+        }
+
+        dec_gen_t::clean();
+    })
+
     .testCase("Autoreferences", [](ostream& os) {
 
         GTree::GTreeIndex tree = vConcatV({vConcatE({e_piano({n(1.0), m(2.0), a(3.0), i(1)}), eAutoref(0)}), vConcatE({eAutoref(1), eAutoref(2)})});
@@ -85,4 +106,223 @@ GTest DecodedGenotypesTest = GTest("Decoded GenotypesTest")
         if (tree.evaluate().toString() != tree.evaluate().toString()) {
             throw runtime_error("Expected reevaluation of random function to be equal.");
         }
+
+        // Seed whose next draw is exactly 0, which is drawn once as any other value
+        GTree::RNG.seed(2463401483);
+        auto zero = v({e_piano({nRnd({}), m(0.1), a(0.1), i(0.1)})});
+        const size_t draws = GTree::RNG.getDraws();
+        const string phenotype = zero.evaluate().toString();
+
+        if (zero.evaluate().toString() != phenotype || GTree::RNG.getDraws() != draws + 1) {
+            throw runtime_error("Expected a random leaf drawing 0 not to be drawn again.");
+        }
+    })
+
+    .testCase("Bad tree declaration", [](ostream& os) {
+        const auto throwsBadParameters = [](std::function<void()> build) {
+            try {
+                build();
+            } catch (runtime_error& e) {
+                return string(e.what()).find(ErrorCodes::BAD_GFUNCTION_PARAMETERS) == 0;
+            }
+            return false;
+        };
+
+        if (!throwsBadParameters([]() { v({n(0.1)}); })) {
+            throw runtime_error("Expected a voice of parameters to be rejected when built.");
+        }
+
+        if (!throwsBadParameters([]() { e_piano({n(0.1), m(0.1), a(0.1)}); })) {
+            throw runtime_error("Expected an event with missing parameters to be rejected when built.");
+        }
+
+        if (!throwsBadParameters([]() { parseString("s(e(n(0.1), m(0.1), a(0.1), i(0.1)))"); })) {
+            throw runtime_error("Expected parsing an ill typed expression to fail.");
+        }
+
+        dec_gen_t::clean();
+    })
+
+    .testCase("Node children storage", [](ostream& os) {
+        auto event = e_piano({n(0.1), m(0.1), a(0.1), i(0.1)});
+        auto list = lm({p(1), p(2), p(3), p(4), p(5), p(6)});
+
+        if (GTree::tree_nodes[event].getChildren().size() != 4 || e_piano.getParamTypes().size() != 4) {
+            throw runtime_error("Expected e_piano nodes to hold four children.");
+        }
+
+        auto children = GTree::tree_nodes[list].getChildren();
+        for (size_t k = 0; k < children.size(); ++k) {
+            if (children[k].getLeafValue() != k + 1) {
+                throw runtime_error("Unexpected list child after spilling inline storage.");
+            }
+        }
+    })
+
+    .testCase("Collect unreachable nodes", [](ostream& os) {
+        const auto build = []() {
+            return vConcatV({vConcatE({e_piano({nRnd({}), m(0.1), a(0.1), i(0.1)}), eAutoref(0)}), vConcatE({eAutoref(1), eAutoref(2)})});
+        };
+
+        GTree::Context fresh_context;
+        std::string expected_genotype, expected_phenotype;
+        {
+            GTree::Context::Scope scope(fresh_context);
+            GTree::RNG.seed(7);
+            auto tree = build();
+            expected_genotype = tree.toString();
+            expected_phenotype = tree.evaluate().toString();
+        }
+
+        // Garbage of the same types before and after the root, which autoreferences of the root do not see
+        vConcatE({e_piano({n(0.9), m(0.9), a(0.9), i(0.9)}), e_piano({n(0.8), m(0.8), a(0.8), i(0.8)})});
+        GTree::RNG.seed(7);
+        dec_gen_t roots[] = { build(), p(0.5) };
+        e_piano({n(0.7), m(0.7), a(0.7), i(0.7)});
+
+        const size_t nodes = GTree::tree_nodes.size();
+        const size_t released = GTree::collect(roots);
+
+        os << GTree::printStaticData() << endl;
+
+        // Three events of 5 nodes and a vConcatE
+        if (released != 3 * 5 + 1 || GTree::tree_nodes.size() != nodes - released) {
+            throw runtime_error("Unexpected number of released nodes: " + to_string(released));
+        }
+
+        if (roots[0].toString() != expected_genotype || roots[0].evaluate().toString() != expected_phenotype) {
+            throw runtime_error("Expected a collected root to evaluate as if built in a context of its own: " + roots[0].evaluate().toString());
+        }
+
+        if (roots[1].getLeafValue() != 0.5 || GTree::collect(roots) != 0) {
+            throw runtime_error("Expected collecting without garbage to keep every node.");
+        }
+
+        if (GTree::collect({}) != 11 + 1 || GTree::tree_nodes.size() || GTree::available_subexpressions.size()) {
+            throw runtime_error("Expected collecting without roots to release every node.");
+        }
+    })
+
+    .testCase("Phenotypes outlive the arena", [](ostream& os) {
+        GTree::clean();
+        const enc_phen_t phenotype = s({vConcatE({e_piano({n(0.1), m(0.2), a(0.3), i(0.4)}), e_piano({n(0.5), m(0.6), a(0.7), i(0.8)})})}).evaluate();
+        const string expected = phenotype.toString();
+
+        // The arena is reset and its storage reused by another evaluation
+        GTree::clean();
+        s({vConcatE({e_piano({n(0.9), m(0.9), a(0.9), i(0.9)}), e_piano({n(0.8), m(0.8), a(0.8), i(0.8)})})}).evaluate(GTree::phenotype_arena);
+
+        if (phenotype.toString() != expected) {
+            throw runtime_error("Expected an evaluated phenotype to own its storage: " + phenotype.toString());
+        }
+        GTree::clean();
+    })
+
+    .testCase("Autoreferences across collect", [](ostream& os) {
+        GTree::clean();
+        const auto build = []() {
+            return vConcatV({vConcatE({e_piano({n(0.1), m(0.1), a(0.1), i(0.1)}), e_piano({n(0.2), m(0.2), a(0.2), i(0.2)})}), vConcatE({eAutoref(1), eAutoref(2)})});
+        };
+
+        GTree::Context fresh_context;
+        std::string expected_phenotype;
+        {
+            GTree::Context::Scope scope(fresh_context);
+            expected_phenotype = build().evaluate().toString();
+        }
+
+        // An earlier unrelated tree, whose event would be chosen if autoreferences counted it
+        dec_gen_t unrelated = v({e_piano({n(0.9), m(0.9), a(0.9), i(0.9)})});
+        dec_gen_t roots[] = { build() };
+        const std::string before = roots[0].evaluate().toString();
+
+        // Every node of the unrelated tree, and only those, is released
+        const size_t unrelated_nodes = unrelated.getIndex() + 1;
+
+        if (GTree::collect(roots) != unrelated_nodes || before != expected_phenotype || roots[0].evaluate().toString() != before) {
+            throw runtime_error("Expected autoreferences to resolve the same before and after collect: " + roots[0].evaluate().toString());
+        }
+        GTree::clean();
+    })
+
+    .testCase("Streamed expressions", [](ostream& os) {
+        auto tree = s({vConcatV({vMotif({ln({n(0.1), n(0.2)}), lm({m(0.1)}), la({a(0.1)}), li({i(0.1)})}), v({e({nRnd({}), m(0.2), a(0.3), i(0.4)})})})});
+        auto phenotype = tree.evaluate();
+
+        os << tree.toString(pretty_expression) << endl;
+        os << phenotype.toString(pretty_expression) << endl;
+
+        if (tree.toString(pretty_expression) != prettyPrint(tree.toString()) || phenotype.toString(pretty_expression) != prettyPrint(phenotype.toString())) {
+            throw runtime_error("Expected the pretty style to lay out expressions as prettyPrint.");
+        }
+
+        // Aliases are written as the function they alias
+        if (tree.toString().find("e_piano(nRnd(), m(0.200000)") == string::npos) {
+            throw runtime_error("Unexpected expression: " + tree.toString());
+        }
+
+        string buffer = "tree: ";
+        GTree::tree_nodes[tree].writeString(buffer);
+        buffer += ", phenotype: ";
+        phenotype.writeString(buffer);
+
+        if (buffer != "tree: " + tree.toString() + ", phenotype: " + phenotype.toString()) {
+            throw runtime_error("Expected expressions to be appended: " + buffer);
+        }
+    })
+
+    .testCase("Deep genotypes", [](ostream& os) {
+        // Far deeper than the call stack would allow to traverse recursively
+        const size_t depth = 50000;
+
+        string expression;
+        for (size_t k = 0; k < depth; ++k) expression += "vConcatV(";
+        expression += "v(e_piano(n(0.1), m(0.2), a(0.3), i(0.4)))";
+        for (size_t k = 0; k < depth; ++k) expression += ", vConcatE(e_piano(n(0.5), m(0.6), a(0.7), i(0.8)), eAutoref(1)))";
+
+        auto tree = parseString(expression);
+        auto phenotype = tree.evaluate();
+
+        if (phenotype.getChildren().size() != 1 + 2 * depth) {
+            throw runtime_error("Unexpected number of events: " + to_string(phenotype.getChildren().size()));
+        }
+
+        const vector<double> normalized = tree.toNormalizedVector();
+        if (normalized.size() != GTree::tree_nodes[tree].normalizedVectorSize() || normalized.front() != 1 || normalized.back() != 0) {
+            throw runtime_error("Unexpected normalized vector of a deep genotype.");
+        }
+
+        if (phenotype.toNormalizedVector().size() != phenotype.normalizedVectorSize()) {
+            throw runtime_error("Unexpected normalized vector of a deep phenotype.");
+        }
+
+        const string written = tree.toString();
+        if (written.rfind("vConcatV(vConcatV(", 0) != 0 || count(written.begin(), written.end(), '(') != count(written.begin(), written.end(), ')')) {
+            throw runtime_error("Unexpected expression of a deep genotype.");
+        }
+    })
+
+    .testCase("Profiler report", [](ostream& os) {
+        Profiler::reset();
+
+        auto tree = vConcatV({vConcatE({e_piano({n(0.1), m(0.1), a(0.1), i(0.1)}), eAutoref(0)}), vConcatE({eAutoref(1), eAutoref(2)})});
+        tree.evaluate();
+
+        auto report = Profiler::snapshot();
+        os << Profiler::toTable() << endl;
+        os << Profiler::toJSON() << endl;
+
+        if (!Profiler::enabled()) {
+            if (report.size()) throw runtime_error("Expected no profiling data when profiling is compiled out.");
+            return;
+        }
+
+        auto it = report.find(Profiler::KeyView{ "vConcatE", Profiler::tree_node });
+        if (it == report.end() || it -> second.calls != 2) {
+            throw runtime_error("Expected two recorded vConcatE evaluations.");
+        }
+
+        if (it -> second.exclusive_ns > it -> second.inclusive_ns) {
+            throw runtime_error("Exclusive time cannot exceed inclusive time.");
+        }
     }); 
\ No newline at end of file
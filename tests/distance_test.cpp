@@ -0,0 +1,79 @@
+#include <cmath>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+static bool near(double a, double b) {
+    return fabs(a - b) < 1e-9;
+}
+
+GTest DistanceTest = GTest("Distance Test")
+
+    .before([]() { init_genomus(); })
+    .beforeEach([]() { GTree::clean(); })
+    .after([]() { GTree::clean(); })
+
+    .testCase("Vector metrics", [](ostream& os) {
+        // Longer than the kernel lanes, so both the vectorized body and the tail are exercised
+        vector<double> a(21), b(19);
+        double expected_l1 = 0, expected_l2 = 0;
+        for (size_t k = 0; k < a.size(); ++k) a[k] = k / 21.0;
+        for (size_t k = 0; k < b.size(); ++k) {
+            b[k] = 1 - k / 19.0;
+            expected_l1 += fabs(a[k] - b[k]);
+            expected_l2 += (a[k] - b[k]) * (a[k] - b[k]);
+        }
+
+        if (!near(l1Distance(a, b), expected_l1) || !near(l2Distance(a, b), sqrt(expected_l2))) {
+            throw runtime_error("Unexpected distance over the aligned prefix.");
+        }
+
+        if (!near(normalizedL1Distance(a, b), (expected_l1 + 2) / 21) || !near(normalizedL2Distance(a, b), sqrt((expected_l2 + 2) / 21))) {
+            throw runtime_error("Unexpected length normalized distance.");
+        }
+
+        if (distance(normalized_l1_distance, a, a) != 0 || normalizedL1Distance({}, {}) != 0 || normalizedL1Distance(a, {}) != 1) {
+            throw runtime_error("Unexpected distance for identical or empty vectors.");
+        }
+    })
+
+    .testCase("One to many distances", [](ostream& os) {
+        vector<vector<double>> vectors;
+        vector<span<const double>> spans;
+        for (size_t k = 0; k < 1000; ++k) vectors.push_back(vector<double>(k % 37, k / 1000.0));
+        for (auto& vector : vectors) spans.push_back(vector);
+
+        const auto result = distances(normalized_l2_distance, vectors[500], spans, 4);
+
+        for (size_t k = 0; k < vectors.size(); ++k) {
+            if (result[k] != normalizedL2Distance(vectors[500], vectors[k])) {
+                throw runtime_error("Unexpected batched distance at " + to_string(k));
+            }
+        }
+    })
+
+    .testCase("Piano event distance", [](ostream& os) {
+        auto first = extractEventFeatures(vConcatE({e_piano({n(0.5), m(60), a(0.1), i(0.1)}), e_piano({n(0.25), m(64), a(0.1), i(0.1)})}).evaluate());
+        auto second = extractEventFeatures(v({e_piano({n(0.5), m(60), a(0.9), i(0.9)})}).evaluate());
+        auto third = extractEventFeatures(v({e_piano({n(0.5), m(72), a(0.1), i(0.1)})}).evaluate());
+
+        if (first.pitches.size() != 2 || first.rhythms.size() != 2) {
+            throw runtime_error("Expected one feature per event.");
+        }
+
+        // Only the missing event differs: articulation and intensity are ignored
+        if (!near(eventDistance(first, second), 0.5) || !near(eventDistance(second, first), 0.5)) {
+            throw runtime_error("Unexpected distance with a missing event.");
+        }
+
+        const auto batch = eventDistances(second, vector<EventFeatures>{ first, second, third });
+        if (batch[1] != 0 || !(batch[2] > 0) || batch[2] != eventDistance(second, third, { .pitch = 0.5, .rhythm = 0.5 })) {
+            throw runtime_error("Unexpected batched event distances.");
+        }
+    });
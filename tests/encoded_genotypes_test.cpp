@@ -1,6 +1,8 @@
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <ostream>
+#include <random>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -47,6 +49,20 @@ GTest EncodedGenotypesTest = GTest("Encoded Genotypes Test")
         }
     })
 
+    .testCase("Decoded genotype encoding size", [](ostream& os) {
+        auto tree = vConcatV({
+            vMotif({ln({p(0.1), p(0.2)}), lm({p(0.1), p(0.2)}), la({p(0.1)}), li({p(0.1), p(0.2), p(0.3)})}),
+            vConcatE({e_piano({nRnd({}), m(0.1), a(0.1), i(0.1)}), eAutoref(0)}),
+        });
+
+        // 3 values per encoded node (list items are not nodes), 2 per parameter leaf or list item
+        const size_t expected_size = 3 * 13 + 2 * 8 + 2 * 4;
+
+        if (GTree::tree_nodes[tree].normalizedVectorSize() != expected_size || tree.toNormalizedVector().size() != expected_size) {
+            throw runtime_error("Unexpected normalized vector size: " + to_string(tree.toNormalizedVector().size()));
+        }
+    })
+
     .testCase("Encoding integers", [](ostream& os) {
 
         std::map<size_t, double> source_of_truth = {
@@ -102,6 +118,42 @@ GTest EncodedGenotypesTest = GTest("Encoded Genotypes Test")
         }
     })
 
+    .testCase("Function selection table", [](ostream& os) {
+        const pair<const FunctionSelectionTable&, const FunctionTypeDictionary&> tables[] = {
+            { function_selection_table, function_type_dictionary },
+            { default_function_selection_table, default_function_type_dictionary },
+        };
+
+        for (auto& [table, dictionary] : tables) {
+            for (auto& [type, functions] : dictionary) {
+                // Function indices, midpoints and their neighbours are the values ties depend on
+                vector<double> values = { -0.5, 0, 1, 1.5, nextafter(1.0, 0.0) };
+                for (size_t k = 0; k < functions.size(); ++k) {
+                    values.push_back(functions[k]);
+                    if (k > 0) values.push_back((functions[k - 1] + functions[k]) / 2);
+                }
+                for (size_t k = 0, size = values.size(); k < size; ++k) {
+                    values.push_back(nextafter(values[k], -1.0));
+                    values.push_back(nextafter(values[k], 2.0));
+                }
+                mt19937 generator(type);
+                uniform_real_distribution<double> distribution(0, 1);
+                for (size_t k = 0; k < 10000; ++k) values.push_back(distribution(generator));
+
+                for (bool include_autoreferences : { false, true }) {
+                    if (!include_autoreferences && functions.size() < 2) continue;
+
+                    for (double value : values) {
+                        const double expected = getClosestFunctionIndex(dictionary, type, value, include_autoreferences);
+                        if (table.select(type, value, include_autoreferences) != expected) {
+                            throw runtime_error("Unexpected selection for " + encodedPhenotypeTypeToString(type) + " at " + to_string(value));
+                        }
+                    }
+                }
+            }
+        }
+    })
+
     .testCase("Germinal vector to genotype", [](ostream& os){
         auto tree =  s({v({e_piano({n(0.1), m(0.1), a(0.1), i(0.1)})})});
         auto v = tree.toNormalizedVector();
@@ -206,5 +258,101 @@ GTest EncodedGenotypesTest = GTest("Encoded Genotypes Test")
 
             // throw runtime_error("Parse and toString are not inverse.");
         }
+    })
+
+    .testCase("Normalized vector validation", [](ostream& os) {
+        const auto expectWellFormed = [&](const vector<double>& v) {
+            const Result<size_t> validation = validateNormalizedVector(v);
+            if (!validation || *validation != v.size()) {
+                throw runtime_error("Unexpected validation: " + (validation ? to_string(*validation) : errorToString(validation.error())));
+            }
+        };
+        const auto expectError = [&](const vector<double>& v, ErrorCodes::ErrorCode code, size_t position) {
+            const Result<size_t> validation = validateNormalizedVector(v);
+            const GenomusError expected = { .code = code, .position = position, .function = {} };
+            if (validation || validation.error().code != code || validation.error().position != position) {
+                throw runtime_error("Unexpected validation: " + (validation ? to_string(*validation) : errorToString(validation.error())) 
+                    + ", expected " + errorToString(expected));
+            }
+        };
+
+        for (size_t k = 0; k < 50; ++k) {
+            vector<double> normalized;
+            normalizeVector(newGerminalVector(), normalized);
+            expectWellFormed(normalized);
+        }
+
+        // s(v(e_piano(n(0.1), m(0.2), a(0.3), i(0.4))))
+        vector<double> score;
+        normalizeVector(s({v({e_piano({n(0.1), m(0.2), a(0.3), i(0.4)})})}).toNormalizedVector(), score);
+        os << humanReadableNormalizedVector(score) << endl;
+        expectWellFormed(score);
+
+        expectError({}, ErrorCodes::bad_normalized_vector_opening_marker, 0);
+        expectError(vector<double>(score.begin(), score.end() - 1), ErrorCodes::bad_normalized_vector_truncated, score.size() - 1);
+
+        vector<double> mutated = score;
+        mutated.push_back(0);
+        expectError(mutated, ErrorCodes::bad_normalized_vector_trailing_values, score.size());
+
+        // Opening marker, index and leaf type marker of n, past s, score and e_piano
+        mutated = score;
+        mutated[6] = 0.5;
+        expectError(mutated, ErrorCodes::bad_normalized_vector_opening_marker, 6);
+
+        mutated = score;
+        mutated[7] += 0.001;
+        expectError(mutated, ErrorCodes::bad_normalized_vector_function_index, 7);
+        if (toExpression(mutated) != toExpression(score)) {
+            throw runtime_error("Expected toExpression to select the closest function index.");
+        }
+
+        mutated = score;
+        mutated[8] = 0.52;
+        expectError(mutated, ErrorCodes::bad_normalized_vector_leaf_type_marker, 8);
+
+        mutated = score;
+        mutated[10] = 0.3;
+        expectError(mutated, ErrorCodes::bad_normalized_vector_closing_marker, 10);
+
+        try {
+            toExpression(mutated);
+        } catch (runtime_error& e) {
+            if (string(e.what()) != "Expected 0 at position 10") throw runtime_error(string("Unexpected error: ") + e.what());
+            return;
+        }
+        throw runtime_error("Expected toExpression to reject a malformed vector.");
+    })
+
+    .testCase("Expression appended to a buffer", [](ostream& os) {
+        std::vector<double> normalized, list;
+        normalizeVector(vConcatE({e_piano({n(0.1), m(0.2), a(0.3), i(0.4)}), e_piano({n(0.5), m(0.6), a(0.7), i(0.8)})}).toNormalizedVector(), normalized);
+        normalizeVector(vMotif({ln({n(0.1), n(0.2), n(0.3)}), lm({m(0.1)}), la({a(0.1)}), li({i(0.1)})}).toNormalizedVector(), list);
+        std::string buffer = "> ";
+
+        toExpression(normalized, buffer);
+        buffer += "; ";
+        toExpression(list, buffer);
+
+        if (buffer != "> " + toExpression(normalized) + "; " + toExpression(list)) {
+            throw runtime_error("Expected expressions to be appended: " + buffer);
+        }
+
+        os << buffer << endl;
+
+        // Lists are written without trailing separators
+        if (buffer.find(", )") != std::string::npos || buffer.find("n(0.100000), n(0.200000), n(0.300000))") == std::string::npos) {
+            throw runtime_error("Unexpected list expression: " + buffer);
+        }
+
+        normalized.back() = 0.5;
+        const std::string written = buffer;
+        try {
+            toExpression(normalized, buffer);
+        } catch (runtime_error& e) {
+            if (buffer != written) throw runtime_error("Expected the buffer to be left as it was on errors.");
+            return;
+        }
+        throw runtime_error("Expected a malformed vector to be rejected.");
     });
 
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <ostream>
 #include <sstream>
@@ -56,5 +57,30 @@ GTest EncodedPhenotypesTest = GTest("Encoded Phenotypes Test")
         auto s = ev.toString();
 
         os << s << endl;
+    })
+
+    .testCase("List normalized vector", [](ostream& os) {
+        auto list = ln({p(0.1), p(0.2)}).evaluate();
+        auto voice = parseString("vConcatE(e_piano(n(0.1), m(0.2), a(0.3), i(0.4)), e_piano(n(0.5), m(0.6), a(0.7), i(0.8)))").evaluate();
+
+        const double marker = leafTypeToNormalizedValue(noteValueF);
+        const vector<double> expected = {
+            integerToNormalized(2),
+            marker, list.getChildren()[0].getLeafValue(),
+            marker, list.getChildren()[1].getLeafValue(),
+        };
+
+        if (list.toNormalizedVector() != expected) {
+            throw runtime_error("Expected list items to be preceded by their type marker: " + to_string(list.toNormalizedVector()));
+        }
+
+        vector<double> buffer = { -1 };
+        list.appendNormalizedVector(buffer);
+        voice.appendNormalizedVector(buffer);
+
+        if (buffer.size() != 1 + list.normalizedVectorSize() + voice.normalizedVectorSize() 
+            || !equal(expected.begin(), expected.end(), buffer.begin() + 1)) {
+            throw runtime_error("Expected normalized vectors to be appended to the buffer.");
+        }
     });
 
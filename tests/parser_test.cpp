@@ -29,4 +29,69 @@ GTest ParserTest = GTest("Parser test")
             std::string error_message = "Assertion error: expected\n\n" + tree_string + "\n\nto equal\n\n" + parsed_tree_string + "\n";
             throw runtime_error(error_message);
         }
-    });
\ No newline at end of file
+    })
+
+    .testCase("Parse errors", [](ostream& os) {
+        const auto expectError = [&](const std::string& entry, ErrorCodes::ErrorCode code, size_t position) {
+            const Result<dec_gen_t> tree = tryParseString(entry);
+            if (tree || tree.error().code != code || tree.error().position != position) {
+                throw runtime_error("Unexpected result for " + entry + ": " + (tree ? tree -> toString() : errorToString(tree.error()))
+                    + ", expected " + errorCodeToString(code) + " at position " + std::to_string(position));
+            }
+            os << entry << "\n" << errorToString(tree.error()) << "\n\n";
+        };
+
+        const std::string valid = "s(v(e_piano(n(0.1), m(0.1), a(0.1), i(0.1))))";
+        if (!tryParseString(valid) || tryParseString(valid) -> toString() != parseString(valid).toString()) {
+            throw runtime_error("Expected a valid entry to be parsed as parseString does.");
+        }
+
+        expectError(valid.substr(0, valid.size() - 1), ErrorCodes::bad_parser_entry_bad_parenthesis, valid.size() - 1);
+        expectError(valid + ")", ErrorCodes::bad_parser_entry_bad_parenthesis, valid.size());
+        expectError("(" + valid + ")", ErrorCodes::bad_parser_entry_bad_parenthesis, 0);
+
+        const std::string unknown = "s(v(e_piano(n(0.1), x(0.1), a(0.1), i(0.1))))";
+        expectError(unknown, ErrorCodes::bad_parser_entry_bad_function_name, unknown.find("x("));
+        if (tryParseString(unknown).error().function != "x") {
+            throw runtime_error("Expected the unknown function name in the error.");
+        }
+
+        const std::string swapped = "s(v(e_piano(n(0.1), a(0.1), m(0.1), i(0.1))))";
+        expectError(swapped, ErrorCodes::bad_gfunction_parameters, swapped.find("a("));
+        const std::string missing = "s(v(e_piano(n(0.1), m(0.1), a(0.1))))";
+        expectError(missing, ErrorCodes::bad_gfunction_parameters, missing.find("e_piano"));
+        const std::string out_of_range = "s(v(e_piano(n(1" + std::string(60, '0') + "), m(0.1), a(0.1), i(0.1))))";
+        expectError(out_of_range, ErrorCodes::bad_gfunction_parameters, out_of_range.find("1"));
+
+        try {
+            parseString(unknown);
+        } catch (runtime_error& e) {
+            if (string(e.what()) != ErrorCodes::BAD_PARSER_ENTRY_BAD_FUNCTION_NAME + ": x") throw runtime_error(string("Unexpected error: ") + e.what());
+            return;
+        }
+        throw runtime_error("Expected parseString to throw the error of tryParseString.");
+    })
+
+    .testCase("Non-throwing evaluation", [](ostream& os) {
+        // The autoreference is the first node, with no earlier event to refer to
+        const auto tree = vConcatE({eAutoref(0), e_piano({n(0.1), m(0.1), a(0.1), i(0.1)})});
+        const Result<enc_phen_t> phenotype = tree.tryEvaluate();
+
+        if (phenotype || phenotype.error().code != ErrorCodes::bad_autoreference || phenotype.error().position != 0) {
+            throw runtime_error("Expected a bad autoreference at node 0.");
+        }
+        os << errorToString(phenotype.error()) << endl;
+
+        // Otherwise the autoreference below could refer to the one above
+        GTree::clean();
+        const auto valid = vConcatE({e_piano({n(0.1), m(0.1), a(0.1), i(0.1)}), eAutoref(0)});
+        if (!valid.tryEvaluate() || valid.tryEvaluate() -> toString() != valid.evaluate().toString()) {
+            throw runtime_error("Expected tryEvaluate to evaluate as evaluate does.");
+        }
+
+        std::vector<double> normalized;
+        const Result<size_t> empty = tryNormalizeVector({}, normalized);
+        if (empty || empty.error().code != ErrorCodes::empty_germinal_vector || !normalized.empty()) {
+            throw runtime_error("Expected empty germinal vectors to be rejected.");
+        }
+    });
@@ -0,0 +1,106 @@
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+GTest PhenotypeCacheTest = GTest("Phenotype Cache Test")
+
+    .before([]() { init_genomus(); })
+    .beforeEach([]() { GTree::clean(); })
+    .after([]() { GTree::clean(); })
+
+    .testCase("Normalized vector hashing", [](ostream& os) {
+        const vector<double> a = { 1, 0.25, 1, 0.5, 0.75, 0 }, b = { 1, 0.25, 1, 0.5, 0.75, 0, 0 };
+
+        if (!(hashNormalizedVector(a) == hashNormalizedVector(vector<double>(a)))) {
+            throw runtime_error("Expected equal vectors to hash equally.");
+        }
+
+        if (hashNormalizedVector(a) == hashNormalizedVector(b) || hashNormalizedVector(a) == hashNormalizedVector(a, 1)) {
+            throw runtime_error("Expected different vectors and seeds to hash differently.");
+        }
+    })
+
+    .testCase("Lookup and seed dependent phenotypes", [](ostream& os) {
+        PhenotypeCache cache;
+        const vector<double> genotype = { 1, 0.5, 0 }, random_genotype = { 1, 0.75, 0 };
+        const vector<double> phenotype = { 0.1, 0.2 }, first_random = { 0.3 }, second_random = { 0.4 };
+        vector<double> out;
+
+        cache.insert(genotype, 1, false, phenotype);
+        cache.insert(random_genotype, 1, true, first_random);
+        cache.insert(random_genotype, 2, true, second_random);
+
+        if (!cache.lookup(genotype, 7, out) || out != phenotype) {
+            throw runtime_error("Expected seed independent phenotypes to be found for any seed.");
+        }
+
+        out.clear();
+        if (!cache.lookup(random_genotype, 2, out) || out != second_random || cache.lookup(random_genotype, 3, out)) {
+            throw runtime_error("Expected seed dependent phenotypes to be found only for their seed.");
+        }
+
+        const auto stats = cache.getStats();
+        if (stats.hits != 2 || stats.misses != 1 || stats.entries != 4 || stats.hitRate() != 2.0 / 3) {
+            throw runtime_error("Unexpected cache counters.");
+        }
+    })
+
+    .testCase("CLOCK eviction", [](ostream& os) {
+        const vector<double> phenotype(64, 0.5);
+        vector<double> out;
+        // Room for two entries in a single shard
+        PhenotypeCache cache(2 * (phenotype.size() * sizeof(double) + 256), 1);
+
+        cache.insert(vector<double>{ 1 }, 0, false, phenotype);
+        cache.insert(vector<double>{ 2 }, 0, false, phenotype);
+        cache.lookup(vector<double>{ 1 }, 0, out);
+        cache.insert(vector<double>{ 3 }, 0, false, phenotype);
+
+        const auto stats = cache.getStats();
+        if (stats.evictions != 1 || stats.entries != 2 || stats.bytes > 2 * (phenotype.size() * sizeof(double) + 256)) {
+            throw runtime_error("Expected the cache to stay within its memory budget.");
+        }
+
+        if (!cache.lookup(vector<double>{ 1 }, 0, out) || cache.lookup(vector<double>{ 2 }, 0, out)) {
+            throw runtime_error("Expected the recently read entry to survive eviction.");
+        }
+    })
+
+    .testCase("Cached population evaluation", [](ostream& os) {
+        PhenotypeCache cache;
+        Population first(2), second(2), uncached(2);
+        first.setPhenotypeCache(&cache);
+        second.setPhenotypeCache(&cache);
+
+        RandomGenerator rng;
+        rng.seed(3);
+        for (size_t k = 0; k < 12; ++k) {
+            vector<double> germinal_vector(10);
+            for (auto& value : germinal_vector) value = rng.nextDouble();
+            first.add(germinal_vector, k);
+            second.add(germinal_vector, k);
+            uncached.add(germinal_vector, k);
+        }
+
+        first.evaluateAll();
+        cache.resetStats();
+        second.evaluateAll();
+        uncached.evaluateAll();
+
+        if (cache.getStats().hits != second.size()) {
+            throw runtime_error("Expected every phenotype of the second population to be cached.");
+        }
+
+        for (size_t k = 0; k < second.size(); ++k) {
+            const auto cached = second.getPhenotypeVector(k), expected = uncached.getPhenotypeVector(k);
+            if (!equal(cached.begin(), cached.end(), expected.begin(), expected.end())) {
+                throw runtime_error("Expected cached phenotypes to match evaluated ones.");
+            }
+        }
+    });
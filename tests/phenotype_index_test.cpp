@@ -0,0 +1,94 @@
+#include <cstdio>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "errorCodes.hpp"
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+static vector<PhenotypeDescriptor> randomDescriptors(size_t size) {
+    vector<PhenotypeDescriptor> descriptors(size);
+    RandomGenerator rng;
+    rng.seed(5);
+
+    for (auto& descriptor : descriptors) {
+        for (auto& value : descriptor) value = rng.nextDouble();
+    }
+
+    return descriptors;
+}
+
+GTest PhenotypeIndexTest = GTest("Phenotype Index Test")
+
+    .testCase("Descriptors", [](ostream& os) {
+        vector<double> phenotype(PHENOTYPE_DESCRIPTOR_SIZE * 2);
+        for (size_t k = 0; k < phenotype.size(); ++k) phenotype[k] = k % 2;
+
+        for (double value : toPhenotypeDescriptor(phenotype)) {
+            if (value != 0.5) throw runtime_error("Expected descriptors to average segments.");
+        }
+
+        const auto short_descriptor = toPhenotypeDescriptor(vector<double>{ 0.25, 0.75 });
+        if (short_descriptor.front() != 0.25 || short_descriptor.back() != 0.75 || toPhenotypeDescriptor({})[0] != 0) {
+            throw runtime_error("Unexpected descriptor of a short vector.");
+        }
+    })
+
+    .testCase("Concurrent insertion and query", [](ostream& os) {
+        const auto descriptors = randomDescriptors(2000);
+        PhenotypeIndex index;
+
+        parallelChunks(descriptors.size(), 4, [&](size_t /*chunk*/, size_t begin, size_t end) {
+            for (size_t k = begin; k < end; ++k) {
+                index.insert(descriptors[k], k);
+                index.query(descriptors[k], 1);
+            }
+        });
+
+        if (index.size() != descriptors.size()) {
+            throw runtime_error("Expected every descriptor to be indexed.");
+        }
+
+        for (size_t k = 0; k < descriptors.size(); k += 97) {
+            const auto neighbours = index.query(descriptors[k], 3);
+            if (neighbours.empty() || neighbours[0].id != k || neighbours[0].distance != 0) {
+                throw runtime_error("Expected an indexed descriptor to be its own nearest neighbour.");
+            }
+        }
+    })
+
+    .testCase("Persistence", [](ostream& os) {
+        const auto descriptors = randomDescriptors(300);
+        const string path = "phenotype_index_test.bin";
+        PhenotypeIndex index({ .tables = 6, .hashes_per_table = 3, .seed = 17 });
+        for (size_t k = 0; k < descriptors.size(); ++k) index.insert(descriptors[k], k * 10);
+
+        index.save(path);
+        auto loaded = PhenotypeIndex::load(path);
+        remove(path.c_str());
+
+        if (loaded -> size() != index.size() || loaded -> getParameters().tables != 6 || loaded -> getParameters().seed != 17) {
+            throw runtime_error("Expected the loaded index to keep its parameters and contents.");
+        }
+
+        for (size_t k = 0; k < descriptors.size(); k += 7) {
+            const auto expected = index.query(descriptors[k], 5), obtained = loaded -> query(descriptors[k], 5);
+            if (expected.size() != obtained.size() || obtained[0].id != k * 10) {
+                throw runtime_error("Expected the loaded index to answer like the saved one.");
+            }
+        }
+
+        bool rejected = false;
+        try {
+            PhenotypeIndex::load("missing_phenotype_index.bin");
+        } catch (runtime_error& e) {
+            rejected = string(e.what()).find(ErrorCodes::INDEX_FILE_NOT_ACCESSIBLE) == 0;
+        }
+        if (!rejected) throw runtime_error("Expected loading a missing file to fail.");
+    });
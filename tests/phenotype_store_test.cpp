@@ -0,0 +1,138 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+static const string store_path = "phenotype_store_test.bin";
+
+static Hash128 key(double value) {
+    return hashNormalizedVector(vector<double>{ value });
+}
+
+GTest PhenotypeStoreTest = GTest("Phenotype Store Test")
+
+    .before([]() { init_genomus(); })
+    .beforeEach([]() { remove(store_path.c_str()); GTree::clean(); })
+    .after([]() { remove(store_path.c_str()); GTree::clean(); })
+
+    .testCase("Records persist across openings", [](ostream& os) {
+        {
+            PhenotypeStore store(store_path);
+            if (!store.append(key(1), false, vector<double>{ 0.1, 0.2 }) || !store.append(key(2), true, vector<double>{})) {
+                throw runtime_error("Expected new records to be appended.");
+            }
+            if (store.append(key(1), false, vector<double>{ 0.3 })) {
+                throw runtime_error("Expected stored keys not to be appended again.");
+            }
+        }
+
+        PhenotypeStore store(store_path);
+        vector<double> out;
+        bool seed_dependent = true;
+
+        if (store.size() != 2 || !store.lookup(key(1), seed_dependent, out) || out != vector<double>{ 0.1, 0.2 } || seed_dependent) {
+            throw runtime_error("Expected records to be read back after reopening the store.");
+        }
+
+        if (!store.lookup(key(2), seed_dependent, out) || !seed_dependent || store.lookup(key(3), seed_dependent, out)) {
+            throw runtime_error("Unexpected seed dependent marker lookup.");
+        }
+    })
+
+    .testCase("Torn appends are ignored and truncated", [](ostream& os) {
+        {
+            PhenotypeStore store(store_path);
+            store.append(key(1), false, vector<double>{ 0.5 });
+        }
+
+        // A crash in the middle of an append leaves an incomplete record at the end of the file
+        {
+            ofstream file(store_path, ios::binary | ios::app);
+            const char torn[20] = { 'G', 'S', 'P', 'R', 1, 2, 3 };
+            file.write(torn, sizeof(torn));
+        }
+
+        PhenotypeStore store(store_path);
+        vector<double> out;
+        bool seed_dependent;
+
+        if (store.size() != 1 || !store.append(key(2), false, vector<double>{ 0.25, 0.75 })) {
+            throw runtime_error("Expected the torn record to be ignored.");
+        }
+
+        PhenotypeStore reopened(store_path);
+        if (reopened.size() != 2 || !reopened.lookup(key(2), seed_dependent, out) || out != vector<double>{ 0.25, 0.75 }) {
+            throw runtime_error("Expected appends after a torn record to be readable.");
+        }
+    })
+
+    .testCase("Shared files and compaction", [](ostream& os) {
+        // Each PhenotypeStore opens its own file description, as separate processes would
+        PhenotypeStore writer(store_path), reader(store_path);
+        vector<double> out;
+        bool seed_dependent;
+
+        for (size_t k = 0; k < 10; ++k) writer.append(key(k), false, vector<double>(k, k / 10.0));
+
+        if (reader.lookup(key(3), seed_dependent, out)) {
+            throw runtime_error("Expected records appended by others to be read after a refresh.");
+        }
+        reader.refresh();
+        if (reader.size() != 10 || !reader.lookup(key(3), seed_dependent, out) || out.size() != 3) {
+            throw runtime_error("Expected refresh to index the records appended by others.");
+        }
+
+        writer.compact([](const Hash128& h) { return !(h == key(3)); });
+        reader.append(key(20), false, vector<double>{ 1 });
+        writer.refresh();
+
+        if (writer.size() != 10 || reader.size() != 10 || writer.lookup(key(3), seed_dependent, out) || !writer.lookup(key(20), seed_dependent, out)) {
+            throw runtime_error("Expected every store to move to the compacted file.");
+        }
+    })
+
+    .testCase("Cache backed by a store", [](ostream& os) {
+        RandomGenerator rng;
+        rng.seed(9);
+        Population population(2);
+        for (size_t k = 0; k < 8; ++k) {
+            vector<double> germinal_vector(10);
+            for (auto& value : germinal_vector) value = rng.nextDouble();
+            population.add(germinal_vector, k);
+        }
+
+        Population restarted = population;
+        {
+            PhenotypeStore store(store_path);
+            PhenotypeCache cache;
+            cache.setStore(&store);
+            population.setPhenotypeCache(&cache);
+            population.evaluateAll();
+        }
+
+        // A new run, with an empty memory cache
+        PhenotypeStore store(store_path);
+        PhenotypeCache cache;
+        cache.setStore(&store);
+        restarted.setPhenotypeCache(&cache);
+        restarted.evaluateAll();
+
+        if (cache.getStats().stored_hits < restarted.size() || cache.getStats().misses) {
+            throw runtime_error("Expected every phenotype to be found in the store.");
+        }
+
+        for (size_t k = 0; k < restarted.size(); ++k) {
+            const auto stored = restarted.getPhenotypeVector(k), evaluated = population.getPhenotypeVector(k);
+            if (!equal(stored.begin(), stored.end(), evaluated.begin(), evaluated.end())) {
+                throw runtime_error("Expected stored phenotypes to match evaluated ones.");
+            }
+        }
+    });
@@ -0,0 +1,92 @@
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+static const size_t population_size = 24;
+
+static Population newPopulation(size_t threads) {
+    Population population(threads);
+    RandomGenerator rng;
+    rng.seed(11);
+
+    for (size_t k = 0; k < population_size; ++k) {
+        vector<double> germinal_vector(8 + k % 5);
+        for (auto& value : germinal_vector) value = rng.nextDouble();
+        population.add(germinal_vector, k);
+    }
+
+    return population;
+}
+
+static bool equal(span<const double> a, const vector<double>& b) {
+    return vector<double>(a.begin(), a.end()) == b;
+}
+
+GTest PopulationTest = GTest("Population Test")
+
+    .before([]() { init_genomus(); })
+    .beforeEach([]() { GTree::clean(); })
+    .after([]() { GTree::clean(); })
+
+    .testCase("Germinal vectors arena", [](ostream& os) {
+        Population population(1);
+        population.add(vector<double>{ 0.1, 0.2 });
+        population.add(vector<double>{});
+        population.add(vector<double>{ 0.3, 0.4, 0.5 }, 7);
+
+        if (population.size() != 3 || !equal(population.getGerminalVector(0), { 0.1, 0.2 })
+            || !population.getGerminalVector(1).empty() || !equal(population.getGerminalVector(2), { 0.3, 0.4, 0.5 })
+            || population.getSeed(2) != 7) {
+            throw runtime_error("Unexpected germinal vectors stored in the population.");
+        }
+
+        if (population.isNormalized() || population.isEvaluated()) {
+            throw runtime_error("Expected no stage to be computed on insertion.");
+        }
+    })
+
+    .testCase("Parallel normalization", [](ostream& os) {
+        Population population = newPopulation(4);
+        population.normalizeAll();
+
+        for (size_t k = 0; k < population.size(); ++k) {
+            const auto germinal_vector = population.getGerminalVector(k);
+            vector<double> expected;
+            normalizeVector(vector<double>(germinal_vector.begin(), germinal_vector.end()), expected);
+
+            if (!equal(population.getNormalizedVector(k), expected)) {
+                throw runtime_error("Unexpected normalized vector for specimen " + to_string(k));
+            }
+        }
+    })
+
+    .testCase("Parallel evaluation", [](ostream& os) {
+        Population sequential = newPopulation(1), parallel = newPopulation(4);
+        sequential.evaluateAll();
+        const Population snapshot = parallel;
+        parallel.evaluateAll();
+
+        if (!parallel.isEvaluated() || snapshot.isNormalized() || !GTree::tree_nodes.empty()) {
+            throw runtime_error("Expected evaluation to only affect the evaluated population.");
+        }
+
+        for (size_t k = 0; k < parallel.size(); ++k) {
+            const auto phenotype_vector = parallel.getPhenotypeVector(k);
+            const auto expected = vector<double>(sequential.getPhenotypeVector(k).begin(), sequential.getPhenotypeVector(k).end());
+
+            if (!equal(phenotype_vector, expected)) {
+                throw runtime_error("Expected phenotypes not to depend on the thread count: specimen " + to_string(k));
+            }
+
+            Specimen specimen = parallel.getSpecimen(k);
+            if (!equal(phenotype_vector, specimen.getEncodedPhenotype().toNormalizedVector())) {
+                throw runtime_error("Expected population phenotypes to match specimen phenotypes: specimen " + to_string(k));
+            }
+        }
+    });
@@ -11,7 +11,18 @@ int main() {
         EncodedPhenotypesTest,
         DecodedGenotypesTest,
         ParserTest,
-        EncodedGenotypesTest
+        EncodedGenotypesTest,
+        SpecimenTest,
+        PopulationTest,
+        DistanceTest,
+        PhenotypeIndexTest,
+        PhenotypeCacheTest,
+        PhenotypeStoreTest,
+        SpeciesTest,
+        TaskPoolTest,
+        ServerTest,
+        BatchTest,
+        BenchTest
     });
 
     GTestErrorState result = g_success;
@@ -0,0 +1,279 @@
+#include <cstdio>
+#include <iostream>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "genomus-core.hpp"
+#include "protocol.hpp"
+#include "server.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+using namespace Protocol;
+
+static const string socket_path = "server_test.sock";
+static const string expression = "s(v(e_piano(n(0.1), m(0.2), a(0.3), i(0.4))))";
+static const size_t max_frame_size = 1 << 16;
+
+// Server running on its own thread for the lifetime of the object
+struct RunningServer {
+    Server server;
+    thread loop;
+
+    RunningServer()
+        : server({ .socket_path = socket_path, .threads = 2, .max_frame_size = max_frame_size }),
+          loop([this]() { this -> server.run(); }) {}
+    ~RunningServer() {
+        this -> server.stop();
+        this -> loop.join();
+    }
+};
+
+// Connections give up after a few seconds, so a server that does not answer fails the test instead of hanging it
+static int connectClient() {
+    const int fd = connectTo(socket_path);
+    const timeval timeout = { .tv_sec = 10, .tv_usec = 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+static string expressionPayload(uint64_t seed, const string& entry) {
+    return PayloadWriter().u64(seed).bytes(entry).str();
+}
+
+static string germinalPayload(uint64_t seed, const vector<double>& germinal_vector) {
+    return PayloadWriter().u64(seed).doubles(germinal_vector).str();
+}
+
+static FrameHeader expectFrame(int fd, FrameType type, uint64_t request_id, string& payload) {
+    FrameHeader header;
+    if (!readFrame(fd, header, payload)) {
+        throw runtime_error("Expected a response to request " + to_string(request_id));
+    }
+    if (header.type != type || header.request_id != request_id) {
+        throw runtime_error("Unexpected response of type " + to_string(header.type) + " to request " + to_string(header.request_id)
+            + ", expected type " + to_string(type) + " to request " + to_string(request_id) + ": " + payload);
+    }
+    return header;
+}
+
+static void expectClosed(int fd) {
+    FrameHeader header;
+    string payload;
+    if (readFrame(fd, header, payload)) throw runtime_error("Expected the server to close the connection.");
+}
+
+GTest ServerTest = GTest("Server Test")
+
+    .before([]() { init_genomus(); remove(socket_path.c_str()); })
+    .after([]() { remove(socket_path.c_str()); })
+
+    .testCase("Frame round-trip", [](ostream& os) {
+        const vector<double> values = { 0.25, 0.5, 1.0 };
+        const string frame = PayloadWriter().header(evaluate_germinal, 42, 4 + 8 + 3 * 8 + 5)
+            .u32(7).u64(1ull << 40).doubles(values).bytes("hello").str();
+
+        PayloadReader reader(frame);
+        const FrameHeader header = reader.header();
+        if (header.type != evaluate_germinal || header.request_id != 42 || header.length != reader.remaining()) {
+            throw runtime_error("Unexpected frame header.");
+        }
+        if (reader.u32() != 7 || reader.u64() != (1ull << 40) || reader.doubles(3) != values || reader.rest() != "hello" || reader.remaining()) {
+            throw runtime_error("Expected the payload to be read as written.");
+        }
+
+        // Counts larger than the payload, even overflowing once multiplied, are rejected before allocating
+        PayloadReader short_reader(frame);
+        try {
+            short_reader.doubles(SIZE_MAX / 4);
+        } catch (runtime_error& e) {
+            if (string(e.what()).find(ErrorCodes::BAD_SERVER_REQUEST) != 0) throw;
+            return;
+        }
+        throw runtime_error("Expected a count larger than the payload to be rejected.");
+    })
+
+    .testCase("Evaluation requests", [](ostream& os) {
+        RunningServer running;
+        const int fd = connectClient();
+        string payload;
+
+        writeFrame(fd, evaluate_expression, 1, expressionPayload(3, expression));
+        expectFrame(fd, result, 1, payload);
+
+        PayloadReader reader(payload);
+        const auto encoded_genotype = reader.doubles(reader.u32());
+        const auto phenotype = reader.doubles(reader.u32());
+        GTree::clean();
+        dec_gen_t tree = parseString(expression);
+        if (reader.rest() != tree.toString() || encoded_genotype != tree.toNormalizedVector() || phenotype != tree.evaluate().toNormalizedVector()) {
+            throw runtime_error("Expected the response to hold the genotype and phenotype of the expression.");
+        }
+
+        writeFrame(fd, evaluate_germinal, 2, germinalPayload(3, { 0.1, 0.5, 0.9 }));
+        expectFrame(fd, result, 2, payload);
+        os << payload.size() << " bytes of germinal vector response" << endl;
+
+        writeFrame(fd, evaluate_expression, 3, expressionPayload(3, "s(v(x(0.1)))"));
+        expectFrame(fd, error, 3, payload);
+        os << payload << endl;
+        close(fd);
+    })
+
+    .testCase("Pipelined requests", [](ostream& os) {
+        RunningServer running;
+        const int fd = connectClient();
+        const size_t requests = 60;
+
+        for (uint64_t id = 0; id < requests; ++id) {
+            if (id % 3 == 0) writeFrame(fd, evaluate_expression, id, expressionPayload(id, expression));
+            if (id % 3 == 1) writeFrame(fd, evaluate_germinal, id, germinalPayload(id, newGerminalVector()));
+            if (id % 3 == 2) writeFrame(fd, stats, id, "");
+        }
+
+        // Responses may arrive in any order, one for every request
+        set<uint64_t> answered;
+        for (size_t k = 0; k < requests; ++k) {
+            FrameHeader header;
+            string payload;
+            if (!readFrame(fd, header, payload)) throw runtime_error("Expected " + to_string(requests) + " responses.");
+
+            const FrameType expected = header.request_id % 3 == 2 ? stats_result : result;
+            if (header.type != expected || !answered.insert(header.request_id).second) {
+                throw runtime_error("Unexpected response to request " + to_string(header.request_id) + ": " + payload);
+            }
+        }
+        if (answered.size() != requests || *answered.rbegin() != requests - 1) {
+            throw runtime_error("Expected every request to be answered once.");
+        }
+        close(fd);
+    })
+
+    .testCase("Batch ordering", [](ostream& os) {
+        RunningServer running;
+        const int fd = connectClient();
+        const uint32_t count = 12;
+
+        PayloadWriter batch_payload;
+        batch_payload.u32(count);
+        for (uint64_t id = 0; id < count; ++id) {
+            // Every fourth request is malformed, and answered with an error in its place
+            const string payload = id % 4 == 3 ? expressionPayload(id, "s(") : expressionPayload(id, expression);
+            batch_payload.header(evaluate_expression, 100 + id, payload.size()).bytes(payload);
+        }
+        writeFrame(fd, batch, 7, batch_payload.str());
+
+        string payload;
+        expectFrame(fd, batch_result, 7, payload);
+        PayloadReader reader(payload);
+        if (reader.u32() != count) throw runtime_error("Expected a response for every request of the batch.");
+
+        for (uint64_t id = 0; id < count; ++id) {
+            const FrameHeader item = reader.header();
+            const FrameType expected = id % 4 == 3 ? error : result;
+            if (item.request_id != 100 + id || item.type != expected) {
+                throw runtime_error("Expected batch responses in request order, got request " + to_string(item.request_id) + " at " + to_string(id));
+            }
+            reader.bytes(item.length);
+        }
+
+        writeFrame(fd, batch, 8, PayloadWriter().u32(0).str());
+        expectFrame(fd, batch_result, 8, payload);
+        close(fd);
+    })
+
+    .testCase("Stats", [](ostream& os) {
+        RunningServer running;
+        const int fd = connectClient();
+        string payload;
+
+        writeFrame(fd, evaluate_expression, 1, expressionPayload(1, expression));
+        expectFrame(fd, result, 1, payload);
+        writeFrame(fd, evaluate_expression, 2, expressionPayload(1, "s(v(x(0.1)))"));
+        expectFrame(fd, error, 2, payload);
+        writeFrame(fd, stats, 3, "");
+        expectFrame(fd, stats_result, 3, payload);
+
+        // Responses already read are counted, and the stats request is not in flight
+        os << payload << endl;
+        for (const string field : { "\"connections_open\": 1", "\"requests\": 3", "\"errors\": 1", "\"in_flight\": 0", "\"responses\": 2", "\"p99\"" }) {
+            if (payload.find(field) == string::npos) throw runtime_error("Expected " + field + " in the stats: " + payload);
+        }
+        close(fd);
+    })
+
+    .testCase("Malformed and oversized frames", [](ostream& os) {
+        RunningServer running;
+        int fd = connectClient();
+        string payload;
+
+        // A batch announcing more requests than its payload holds used to terminate the server
+        writeFrame(fd, batch, 1, PayloadWriter().u32(0xffffffff).str());
+        expectFrame(fd, error, 1, payload);
+        os << payload << endl;
+
+        writeFrame(fd, batch, 2, PayloadWriter().u32(2).header(stats, 3, 0).str());
+        expectFrame(fd, error, 2, payload);
+
+        writeFrame(fd, evaluate_germinal, 4, PayloadWriter().u64(1).u32(0).str());
+        expectFrame(fd, error, 4, payload);
+
+        writeFrame(fd, evaluate_germinal, 5, PayloadWriter().u64(1).str());
+        expectFrame(fd, error, 5, payload);
+
+        writeFrame(fd, static_cast<FrameType>(0x42), 6, "");
+        expectFrame(fd, error, 6, payload);
+
+        // The connection still serves requests after malformed payloads
+        writeFrame(fd, stats, 7, "");
+        expectFrame(fd, stats_result, 7, payload);
+
+        // Bad headers close the connection, without reading the frame they announce
+        const string oversized = PayloadWriter().header(evaluate_expression, 8, max_frame_size + 1).str();
+        send(fd, oversized.data(), oversized.size(), MSG_NOSIGNAL);
+        expectFrame(fd, error, 8, payload);
+        expectClosed(fd);
+        close(fd);
+
+        fd = connectClient();
+        string bad_magic = PayloadWriter().header(stats, 9, 0).str();
+        bad_magic[0] = 'X';
+        send(fd, bad_magic.data(), bad_magic.size(), MSG_NOSIGNAL);
+        expectFrame(fd, error, 9, payload);
+        expectClosed(fd);
+        close(fd);
+
+        fd = connectClient();
+        writeFrame(fd, stats, 10, "");
+        expectFrame(fd, stats_result, 10, payload);
+        close(fd);
+    })
+
+    .testCase("Clients that do not read", [](ostream& os) {
+        RunningServer running;
+        const int idle = connectClient();
+        const size_t requests = 20000;
+
+        // Far more responses than the socket buffers hold, never read
+        string frames;
+        for (uint64_t id = 0; id < requests; ++id) frames += PayloadWriter().header(stats, id, 0).str();
+        send(idle, frames.data(), frames.size(), MSG_NOSIGNAL);
+
+        const int fd = connectClient();
+        string payload;
+        writeFrame(fd, evaluate_expression, 1, expressionPayload(1, expression));
+        expectFrame(fd, result, 1, payload);
+        close(fd);
+
+        // The responses of the idle client were kept for it
+        for (uint64_t id = 0; id < requests; ++id) expectFrame(idle, stats_result, id, payload);
+        close(idle);
+    });
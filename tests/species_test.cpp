@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+using TestEventLayout = EventLayout<durationF, frequencyF>;
+
+static_assert(PianoEventLayout::field_count == 4);
+static_assert(PianoEventLayout::offset<noteValueF> == 0 && PianoEventLayout::offset<intensityF> == 3);
+static_assert(TestEventLayout::offset<frequencyF> == 1);
+
+GTest SpeciesTest = GTest("Species Test")
+
+    .before([]() { init_genomus(); })
+    .beforeEach([]() { GTree::clean(); })
+    .after([]() { GTree::clean(); })
+
+    .testCase("Event function generated from the layout", [](ostream& os) {
+        const auto param_types = e_piano.getParamTypes();
+
+        if (!equal(param_types.begin(), param_types.end(), PianoEventLayout::fields.begin(), PianoEventLayout::fields.end())) {
+            throw runtime_error("Expected e_piano to take the fields of the piano layout.");
+        }
+
+        if (piano.getEventFunctionName() != e_piano.getName() || piano.getFieldCount() != 4) {
+            throw runtime_error("Unexpected piano species.");
+        }
+
+        os << piano.toString() << endl;
+    })
+
+    .testCase("Species side by side", [](ostream& os) {
+        const Species test_species = Species::fromLayout<TestEventLayout>("test", "e_test");
+
+        auto piano_event = piano.Event({
+            EncodedPhenotype({ .type = noteValueF, .child_type = leafF, .children = {}, .format = value_format, .leaf_value = 0.25 }),
+            EncodedPhenotype({ .type = midiPitchF, .child_type = leafF, .children = {}, .format = value_format, .leaf_value = 0.5 }),
+            EncodedPhenotype({ .type = articulationF, .child_type = leafF, .children = {}, .format = value_format, .leaf_value = 0.5 }),
+            EncodedPhenotype({ .type = intensityF, .child_type = leafF, .children = {}, .format = value_format, .leaf_value = 0.5 }),
+        });
+        auto test_event = test_species.Event({
+            EncodedPhenotype({ .type = durationF, .child_type = leafF, .children = {}, .format = value_format, .leaf_value = 0.125 }),
+            EncodedPhenotype({ .type = frequencyF, .child_type = leafF, .children = {}, .format = value_format, .leaf_value = 0.75 }),
+        });
+
+        if (piano_event.getChildren()[PianoEventLayout::offset<noteValueF>].getLeafValue() != 0.25
+            || test_event.getChildren()[TestEventLayout::offset<frequencyF>].getLeafValue() != 0.75) {
+            throw runtime_error("Expected event fields at their layout offsets.");
+        }
+
+        try {
+            test_species.Event({ piano_event.getChildren()[0], piano_event.getChildren()[1] });
+        } catch (runtime_error& e) {
+            return;
+        }
+        throw runtime_error("Expected events not matching the species layout to be rejected.");
+    });
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+static const vector<double> germinal_vector = { 0.3, 0.7, 0.1, 0.9, 0.5, 0.2, 0.8, 0.4, 0.6, 0.05, 0.95, 0.35 };
+
+GTest SpecimenTest = GTest("Specimen Test")
+
+    .before([]() { init_genomus(); })
+    .beforeEach([]() { GTree::clean(); })
+    .after([]() { GTree::clean(); })
+
+    .testCase("Stages are computed lazily", [](ostream& os) {
+        Specimen specimen(germinal_vector);
+
+        if (specimen.hasEncodedGenotype() || specimen.hasDecodedGenotype() || specimen.hasEncodedPhenotype()) {
+            throw runtime_error("Expected no stage to be computed on construction.");
+        }
+
+        specimen.getDecodedGenotype();
+
+        if (!specimen.hasEncodedGenotype() || !specimen.hasDecodedGenotype() || specimen.hasEncodedPhenotype()) {
+            throw runtime_error("Expected only the stages up to the decoded genotype to be computed.");
+        }
+
+        if (specimen.getContext().tree_nodes.empty() || !GTree::tree_nodes.empty()) {
+            throw runtime_error("Expected the decoded genotype to be built in the specimen context.");
+        }
+
+        os << specimen.getEncodedPhenotype().toString() << endl;
+    })
+
+    .testCase("Stages are cached and owned by the specimen", [](ostream& os) {
+        Specimen specimen(germinal_vector);
+        const string phenotype = specimen.getEncodedPhenotype().toString();
+
+        const auto* cached = &specimen.getEncodedPhenotype();
+        GTree::clean();
+        s({v({e_piano({n(0.1), m(0.1), a(0.1), i(0.1)})})}).evaluate();
+
+        if (cached != &specimen.getEncodedPhenotype() || specimen.getEncodedPhenotype().toString() != phenotype) {
+            throw runtime_error("Expected the cached phenotype to survive GTree::clean().");
+        }
+
+        GTree::Context::Scope scope(specimen.getContext());
+        if (specimen.getDecodedGenotype().evaluate().toString() != phenotype) {
+            throw runtime_error("Expected the decoded genotype to evaluate within the specimen context.");
+        }
+    })
+
+    .testCase("Same seed, same phenotype", [](ostream& os) {
+        Specimen first(germinal_vector, 7), second(germinal_vector, 7);
+
+        if (first.getEncodedPhenotype().toNormalizedVector() != second.getEncodedPhenotype().toNormalizedVector()) {
+            throw runtime_error("Expected specimens with equal genotype and seed to be equal.");
+        }
+    })
+
+    .testCase("Move assignment keeps cached stages", [](ostream& os) {
+        Specimen first(germinal_vector, 1), second(germinal_vector, 2);
+        first.getEncodedPhenotype();
+        const string phenotype = second.getEncodedPhenotype().toString();
+
+        // The phenotype of first is released along with its context, and second's moves with its own
+        first = std::move(second);
+
+        if (!first.hasEncodedPhenotype() || first.getSeed() != 2 || first.getEncodedPhenotype().toString() != phenotype) {
+            throw runtime_error("Expected a move assigned specimen to hold the stages of the other.");
+        }
+
+        Specimen third(germinal_vector, 3);
+        third.getEncodedPhenotype();
+        first = std::move(third);
+        os << first.getEncodedPhenotype().toString() << endl;
+    });
@@ -0,0 +1,91 @@
+#include <atomic>
+#include <iostream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "genomus-core.hpp"
+#include "testing_utils.hpp"
+
+using namespace std;
+
+// Evaluates an expression in a context of its own, sequentially or with the pool
+static string evaluateIn(const string& expression, size_t seed, TaskPool* pool, size_t min_parallel_size) {
+    GTree::Context context;
+    GTree::Context::Scope scope(context);
+    GTree::RNG.seed(seed);
+
+    dec_gen_t tree = parseString(expression);
+    return (pool ? tree.evaluate(*pool, min_parallel_size) : tree.evaluate()).toString();
+}
+
+GTest TaskPoolTest = GTest("Task Pool Test")
+
+    .before([]() { init_genomus(); })
+    .beforeEach([]() { GTree::clean(); })
+    .after([]() { GTree::clean(); })
+
+    .testCase("Every task runs once", [](ostream& os) {
+        TaskPool pool(3);
+        vector<atomic<size_t>> runs(1000);
+
+        pool.forEach(runs.size(), [&](size_t k) {
+            // Nested forks are run by the waiting threads too
+            pool.forEach(4, [&](size_t) { runs[k]++; });
+        });
+
+        for (size_t k = 0; k < runs.size(); ++k) {
+            if (runs[k] != 4) throw runtime_error("Unexpected number of runs of task " + to_string(k) + ": " + to_string(runs[k]));
+        }
+    })
+
+    .testCase("Task exceptions", [](ostream& os) {
+        TaskPool pool(2);
+        atomic<size_t> runs = 0;
+
+        try {
+            pool.forEach(16, [&](size_t k) {
+                runs++;
+                if (k == 5) throw runtime_error("task 5");
+            });
+        } catch (runtime_error& e) {
+            if (string(e.what()) != "task 5" || runs != 16) {
+                throw runtime_error("Expected every task to run and the exception to be rethrown.");
+            }
+            return;
+        }
+
+        throw runtime_error("Expected the task exception to be rethrown.");
+    })
+
+    .testCase("Parallel evaluation of a large score", [](ostream& os) {
+        TaskPool pool(4);
+
+        string voice = "vConcatE(e_piano(nRnd(), m(0.2), a(0.3), i(0.4)), eAutoref(0))";
+        for (size_t level = 0; level < 8; ++level) {
+            voice = "vConcatV(" + voice + ", vConcatE(e_piano(n(0." + to_string(level + 1) + "), mRnd(), a(0.3), i(0.4)), eAutoref(" + to_string(level) + ")))";
+        }
+        const string expression = "s2V(" + voice + ", " + voice + ")";
+
+        const string expected = evaluateIn(expression, 3, nullptr, 0);
+        for (size_t min_parallel_size : { (size_t) 1, (size_t) 16, (size_t) PARALLEL_EVALUATION_MIN_SIZE }) {
+            if (evaluateIn(expression, 3, &pool, min_parallel_size) != expected) {
+                throw runtime_error("Parallel evaluation differs with min_parallel_size = " + to_string(min_parallel_size));
+            }
+        }
+    })
+
+    .testCase("Parallel evaluation of random genotypes", [](ostream& os) {
+        TaskPool pool(3);
+
+        for (size_t k = 0; k < 20; ++k) {
+            vector<double> normalized;
+            normalizeVector(newGerminalVector(), normalized);
+            const string expression = toExpression(normalized);
+
+            if (evaluateIn(expression, k, &pool, 1) != evaluateIn(expression, k, nullptr, 0)) {
+                throw runtime_error("Parallel evaluation differs for " + expression);
+            }
+        }
+    });
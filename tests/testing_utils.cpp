@@ -58,6 +58,7 @@ GTest::GTest(string title) {
     this -> _test_cases = vector<GTestCase>();
     this -> _n_success = 0;
     this -> _before = [](ostream&) { return; };
+    this -> _before_each = [](ostream&) { return; };
     this -> _after = [](ostream&) { return; };
 }
 
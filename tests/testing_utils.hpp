@@ -1,5 +1,7 @@
 
 #include <functional>
+#include <ostream>
+#include <string>
 #include <vector>
 
 using namespace std;
@@ -51,4 +53,15 @@ extern GTest
     EncodedPhenotypesTest,
     DecodedGenotypesTest,
     ParserTest,
-    EncodedGenotypesTest;
\ No newline at end of file
+    EncodedGenotypesTest,
+    SpecimenTest,
+    PopulationTest,
+    DistanceTest,
+    PhenotypeIndexTest,
+    PhenotypeCacheTest,
+    PhenotypeStoreTest,
+    SpeciesTest,
+    TaskPoolTest,
+    ServerTest,
+    BatchTest,
+    BenchTest;
\ No newline at end of file